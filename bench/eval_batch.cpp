@@ -0,0 +1,100 @@
+#include "evaluate.h"
+#include "movegen.h"
+#include "position.h"
+#include "walk.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// positions/sec of Evaluator::evaluateBatch against evalPositional called one
+// position at a time, over the positions of random games from the start
+// position. the checksums must match.
+// usage: wyvern_bench_eval_batch [positions] [threads] [rounds]
+
+namespace
+{
+
+constexpr int game_plies = 24;
+
+std::vector<Wyvern::Position> randomPositions(Wyvern::MoveGenerator& movegen, size_t count)
+{
+  std::vector<Wyvern::Position> positions;
+  positions.reserve(count);
+  U64 state = 1;
+  while (positions.size() < count)
+  {
+    Wyvern::Position pos;
+    for (int ply = 0; ply < game_plies && positions.size() < count; ply++)
+    {
+      Wyvern::MoveList moves;
+      Bench::generateMoves(movegen, pos, moves);
+      if (moves.size() == 0)
+        break;
+      pos.makeMove(moves[xorshift64star(state) % moves.size()]);
+      positions.push_back(pos);
+    }
+  }
+  return positions;
+}
+
+template <typename F> void run(const char* name, size_t positions, int rounds, F evaluate)
+{
+  long long checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++)
+    checksum += evaluate();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << name << ": positions=" << positions * rounds << " time=" << elapsed.count()
+            << "s positions/sec=" << static_cast<U64>(positions * rounds / elapsed.count())
+            << " checksum=" << checksum << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  size_t count = (argc > 1) ? std::atoll(argv[1]) : 100000;
+  int threads = (argc > 2) ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+  int rounds = (argc > 3) ? std::atoi(argv[3]) : 10;
+
+  auto mt = Wyvern::MagicTable::shared();
+  Wyvern::MoveGenerator movegen(mt);
+  const std::vector<Wyvern::Position> positions = randomPositions(movegen, count);
+  std::vector<int> evals(positions.size());
+
+  Wyvern::Evaluator evaluator(mt);
+  auto sum = [&evals]()
+  {
+    long long total = 0;
+    for (int eval : evals)
+      total += eval;
+    return total;
+  };
+  run("one at a time", positions.size(), rounds,
+      [&]()
+      {
+        for (size_t i = 0; i < positions.size(); i++)
+          evals[i] = evaluator.evalPositional(positions[i]);
+        return sum();
+      });
+  run("batch 1 thread", positions.size(), rounds,
+      [&]()
+      {
+        evaluator.evaluateBatch(positions, evals, 1);
+        return sum();
+      });
+  if (threads <= 1)
+    return 0;
+  std::string name = "batch " + std::to_string(threads) + " threads";
+  run(name.c_str(), positions.size(), rounds,
+      [&]()
+      {
+        evaluator.evaluateBatch(positions, evals, threads);
+        return sum();
+      });
+  return 0;
+}
@@ -0,0 +1,53 @@
+#include "evaluate.h"
+#include "movegen.h"
+#include "position.h"
+#include "simd.h"
+#include "walk.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+// evals/sec of the hand written evaluation with scalar and with avx2 mobility,
+// at every leaf of a walk from kiwipete, depth 3 by default. the checksums of
+// the two must match.
+// usage: wyvern_bench_eval_simd [depth]
+
+namespace
+{
+
+void run(const char* name, Wyvern::MoveGenerator& movegen, Wyvern::Evaluator& evaluator,
+         Wyvern::Position pos, int depth)
+{
+  long long checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  U64 evals = Bench::walk(movegen, pos, depth, [&](const Wyvern::Position& leaf)
+                          { checksum += evaluator.evalPositional(leaf); });
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << name << ": evals=" << evals << " time=" << elapsed.count()
+            << "s evals/sec=" << static_cast<U64>(evals / elapsed.count())
+            << " checksum=" << checksum << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  int depth = (argc > 1) ? std::atoi(argv[1]) : 3;
+
+  auto mt = Wyvern::MagicTable::shared();
+  Wyvern::MoveGenerator movegen(mt);
+  Wyvern::Evaluator evaluator(mt);
+  Wyvern::Position pos("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R");
+
+  evaluator.setSimdMobility(false);
+  run("scalar", movegen, evaluator, pos, depth);
+  if (!Wyvern::cpuHasAvx2())
+  {
+    std::cout << "avx2: not supported by this cpu" << std::endl;
+    return 0;
+  }
+  evaluator.setSimdMobility(true);
+  run("avx2", movegen, evaluator, pos, depth);
+  return 0;
+}
@@ -0,0 +1,72 @@
+#include "evaluate.h"
+#include "movegen.h"
+#include "nnue.h"
+#include "position.h"
+#include "walk.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// evals/sec of the hand written evaluation and of the nnue network, at every
+// leaf of a walk from kiwipete, depth 3 by default. the walk's makes and unmakes are timed
+// too, since that is where the network's accumulators are updated; the nnue is
+// also timed refreshing its accumulators at every leaf instead. without a
+// weight file the network has random weights, which cost the same to run.
+// usage: wyvern_bench_nnue [weights|-] [depth]
+
+namespace
+{
+
+void run(const char* name, Wyvern::MoveGenerator& movegen, Wyvern::Evaluator& evaluator,
+         Wyvern::Position pos, int depth)
+{
+  long long checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  U64 evals = Bench::walk(movegen, pos, depth, [&](const Wyvern::Position& leaf)
+                          { checksum += evaluator.evalPositional(leaf); });
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << name << ": evals=" << evals << " time=" << elapsed.count()
+            << "s evals/sec=" << static_cast<U64>(evals / elapsed.count())
+            << " checksum=" << checksum << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  auto network = std::make_shared<Wyvern::NnueNetwork>();
+  if (argc > 1 && argv[1][0] != '-')
+  {
+    if (!network->load(argv[1]))
+    {
+      std::cerr << "cannot load " << argv[1] << std::endl;
+      return 1;
+    }
+  }
+  else
+  {
+    std::vector<int16_t> words(Wyvern::NnueNetwork::file_size / sizeof(int16_t));
+    U64 state = 1;
+    for (int16_t& w : words)
+      w = static_cast<int16_t>(xorshift64star(state) % 64) - 32;
+    network->load(reinterpret_cast<const char*>(words.data()), Wyvern::NnueNetwork::file_size);
+  }
+  int depth = (argc > 2) ? std::atoi(argv[2]) : 3;
+
+  auto mt = Wyvern::MagicTable::shared();
+  Wyvern::MoveGenerator movegen(mt);
+  Wyvern::Evaluator classical(mt);
+  Wyvern::Evaluator nnue(mt);
+  nnue.setNetwork(network);
+  Wyvern::Position pos("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R");
+
+  std::cout << "nnue kernel=" << Wyvern::nnue_kernel << std::endl;
+  run("classical", movegen, classical, pos, depth);
+  run("nnue refresh", movegen, nnue, pos, depth);
+  pos.setNetwork(network.get());
+  run("nnue incremental", movegen, nnue, pos, depth);
+  return 0;
+}
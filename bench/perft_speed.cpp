@@ -0,0 +1,52 @@
+#include "magicbb.h"
+#include "position.h"
+#include "search.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// perft nodes/sec on the start position and on kiwipete, which is dense in
+// captures, promotions, en passant and castling.
+// usage: wyvern_bench_perft [depth] [threads] [hash_mb]
+
+namespace
+{
+
+void runPerft(Wyvern::Search& search, const std::string& name, Wyvern::Position pos, int depth,
+              const Wyvern::PerftOptions& options)
+{
+  auto start = std::chrono::steady_clock::now();
+  U64 nodes = search.perft(pos, depth, options).nodes;
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << name << " backend=" << Wyvern::slider_backend << " depth=" << depth
+            << " threads=" << options.threads << " hash=" << options.hash_mb
+            << "MB nodes=" << nodes << " time=" << elapsed.count()
+            << "s nps=" << static_cast<U64>(nodes / elapsed.count()) << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  int depth = 4;
+  int threads = 1;
+  size_t hash_mb = 0;
+  if (argc > 1)
+    depth = std::atoi(argv[1]);
+  if (argc > 2)
+    threads = std::atoi(argv[2]);
+  if (argc > 3)
+    hash_mb = std::atoi(argv[3]);
+
+  Wyvern::Search search;
+  Wyvern::PerftOptions options;
+  options.threads = threads;
+  options.hash_mb = hash_mb;
+  runPerft(search, "startpos", Wyvern::Position(), depth + 1, options);
+  runPerft(search, "kiwipete",
+           Wyvern::Position("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"),
+           depth, options);
+  return 0;
+}
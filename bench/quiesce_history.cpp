@@ -0,0 +1,117 @@
+#include "magicbb.h"
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+#include "walk.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+// quiescence nodes/sec at move 10 and at move 150 of the same game. the game is
+// played with random non-captures, with a pawn push (or, if the pawns are
+// blocked, a capture) whenever the fifty move counter gets high, so that both
+// positions keep most of their material and differ mainly in the length of
+// their move history.
+// usage: wyvern_bench_quiesce [seconds]
+
+namespace
+{
+
+U64 lcg(U64& state)
+{
+  state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return state >> 33;
+}
+
+U32 pickMove(Wyvern::MoveGenerator& movegen, Wyvern::Position& pos, U64& rng)
+{
+  Wyvern::MoveList moves;
+  Bench::generateMoves(movegen, pos, moves);
+  Wyvern::MoveList quiets;
+  Wyvern::MoveList pawn_pushes;
+  Wyvern::MoveList captures;
+  for (U32 move : moves)
+  {
+    if (move & Wyvern::YES_CAPTURE)
+    {
+      captures.emplace_back(move);
+      continue;
+    }
+    quiets.emplace_back(move);
+    if ((move & Wyvern::MOVE_ALL_PIECES) == Wyvern::MOVE_PAWN)
+      pawn_pushes.emplace_back(move);
+  }
+  if (pos.getHMC() >= 20 && !pawn_pushes.empty())
+    return pawn_pushes[lcg(rng) % pawn_pushes.size()];
+  if (pos.getHMC() >= 40 && !captures.empty())
+    return captures[lcg(rng) % captures.size()];
+  if (!quiets.empty())
+    return quiets[lcg(rng) % quiets.size()];
+  if (!moves.empty())
+    return moves[lcg(rng) % moves.size()];
+  return Wyvern::MOVE_NONE;
+}
+
+double quiesceNps(Wyvern::Search& search, Wyvern::Position& pos, double seconds, U64& nodes)
+{
+  nodes = 0;
+  double elapsed_total = 0;
+  while (elapsed_total < seconds)
+  {
+    search.clearHash();
+    U64 before = search.getQuiesceNodeCount();
+    auto start = std::chrono::steady_clock::now();
+    if (pos.getToMove() == Wyvern::COLOR_WHITE)
+      search.negamax<Wyvern::COLOR_WHITE>(pos, 0, -INT32_MAX, INT32_MAX, true, 0);
+    else
+      search.negamax<Wyvern::COLOR_BLACK>(pos, 0, -INT32_MAX, INT32_MAX, true, 0);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    elapsed_total += elapsed.count();
+    if (search.getQuiesceNodeCount() == before)
+      break; // game over at the root
+    nodes += search.getQuiesceNodeCount() - before;
+  }
+  return nodes / elapsed_total;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  double seconds = 2;
+  if (argc > 1)
+    seconds = std::atof(argv[1]);
+
+  Wyvern::MoveGenerator movegen(Wyvern::MagicTable::shared());
+  Wyvern::Search search;
+  search.setHashSize(1);
+
+  // replay with a new seed until a game lasts the full 300 plies
+  Wyvern::Position game;
+  Wyvern::Position at_move_10;
+  for (U64 seed = 1; game.getGamePly() < 300; seed++)
+  {
+    U64 rng = seed;
+    game = Wyvern::Position();
+    for (int ply = 0; ply < 300; ply++)
+    {
+      if (ply == 20)
+        at_move_10 = game;
+      U32 move = pickMove(movegen, game, rng);
+      if (move == Wyvern::MOVE_NONE)
+        break;
+      game.makeMove(move);
+    }
+  }
+
+  U64 nodes = 0;
+  double nps = quiesceNps(search, at_move_10, seconds, nodes);
+  std::cout << "move=10 history=" << at_move_10.getGamePly() << " qs_nodes=" << nodes
+            << " nps=" << static_cast<U64>(nps) << std::endl;
+  nps = quiesceNps(search, game, seconds, nodes);
+  std::cout << "move=" << game.getGamePly() / 2 << " history=" << game.getGamePly()
+            << " qs_nodes=" << nodes << " nps=" << static_cast<U64>(nps) << std::endl;
+  return 0;
+}
@@ -0,0 +1,96 @@
+#include "position.h"
+#include "search.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iterator>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// nodes Search::bestmove takes to reach a fixed depth over a fixed set of
+// positions, with principal variation search, aspiration windows, null move
+// pruning and killer, countermove and history move ordering turned on one after
+// the other, and the share of beta cutoffs on the first move. single threaded
+// and from a clear table, so the counts are repeatable.
+// usage: wyvern_bench_search [depth]
+
+namespace
+{
+
+constexpr const char* suite[] = {
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+  "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 8",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+  "8/5pk1/6p1/8/3R4/6P1/5PK1/3r4 w - - 0 1",
+  "4k3/8/8/8/8/8/4P3/4K3 w - - 0 1",
+  "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1",
+};
+
+struct Config
+{
+  const char* name;
+  bool pvs;
+  bool aspiration;
+  bool null_move;
+  bool ordering;
+};
+
+constexpr Config configs[] = {
+  {"full windows", false, false, false, false},
+  {"pvs", true, false, false, false},
+  {"pvs+aspiration", true, true, false, false},
+  {"pvs+aspiration+null move", true, true, true, false},
+  {"pvs+aspiration+null move+ordering", true, true, true, true},
+};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  int depth = 5;
+  if (argc > 1)
+    depth = std::atoi(argv[1]);
+
+  U64 base_nodes = 0;
+  for (const Config& config : configs)
+  {
+    U64 total_nodes = 0;
+    std::string moves;
+    double seconds = 0;
+    double first_move_rate = 0;
+    for (const char* fen : suite)
+    {
+      Wyvern::Search search;
+      search.setPrincipalVariationSearch(config.pvs);
+      search.setAspirationWindows(config.aspiration);
+      search.setNullMovePruning(config.null_move);
+      search.setMoveOrdering(config.ordering);
+      search.setUciOutput(true);
+      search.clearHash();
+      Wyvern::GoLimits limits;
+      limits.depth = depth;
+      search.startClock(limits, Wyvern::Position(fen).getToMove());
+      // the info lines are not wanted here
+      std::ostringstream discard;
+      std::streambuf* stdout_buf = std::cout.rdbuf(discard.rdbuf());
+      int eval = 0;
+      auto start = std::chrono::steady_clock::now();
+      U32 move = search.bestmove(Wyvern::Position(fen), limits, eval);
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      std::cout.rdbuf(stdout_buf);
+      seconds += elapsed.count();
+      total_nodes += search.getNodeCount();
+      first_move_rate += search.getFirstMoveCutoffRate() / std::size(suite);
+      moves += " " + moveString(move);
+    }
+    if (base_nodes == 0)
+      base_nodes = total_nodes;
+    std::cout << config.name << ": depth=" << depth << " nodes=" << total_nodes
+              << " ratio=" << static_cast<double>(total_nodes) / base_nodes
+              << " first_move_cutoffs=" << first_move_rate << " time=" << seconds
+              << "s moves=" << moves << std::endl;
+  }
+  return 0;
+}
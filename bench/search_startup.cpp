@@ -0,0 +1,47 @@
+#include "search.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+// cost of creating a Search: the first one in the process builds the shared
+// attack tables, later ones should cost next to nothing. a short search is
+// timed as well, since that is when the transposition table gets allocated.
+// usage: wyvern_bench_startup [searches]
+
+int main(int argc, char** argv)
+{
+  int searches = 1000;
+  if (argc > 1)
+    searches = std::atoi(argv[1]);
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    Wyvern::Search first;
+  }
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << "first Search: " << elapsed.count() << "us" << std::endl;
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < searches; i++)
+  {
+    Wyvern::Search search;
+  }
+  elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << "later Search: " << elapsed.count() / searches << "us each over " << searches
+            << std::endl;
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 10; i++)
+  {
+    Wyvern::Search search;
+    search.setHashSize(1);
+    Wyvern::Position position;
+    int eval = 0;
+    search.bestmove(position, 1, 1, 1, eval);
+  }
+  elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << "Search with 1MB hash and a depth 1 search: " << elapsed.count() / 10 << "us each"
+            << std::endl;
+  return 0;
+}
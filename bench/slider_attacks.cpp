@@ -0,0 +1,88 @@
+#include "magicbb.h"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// slider attack lookups/sec through the per-square MagicBB tables and through
+// MagicTable::attacks, over the same random squares and occupancies.
+// usage: wyvern_bench_slider [lookups]
+
+namespace
+{
+
+U64 splitmix(U64& state)
+{
+  U64 z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+struct Query
+{
+  int sq;
+  U64 occ;
+};
+
+// with dependent set, each occupancy depends on the previous result so that
+// lookups cannot overlap and the loop measures latency rather than throughput
+template <typename Lookup>
+double lookupsPerSec(const std::vector<Query>& queries, U64 lookups, bool dependent, Lookup lookup)
+{
+  U64 sum = 0;
+  U64 last = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (U64 i = 0; i < lookups; i++)
+  {
+    const Query& q = queries[i & (queries.size() - 1)];
+    last = lookup(q.sq, q.occ ^ (dependent ? (last & 1) : 0));
+    sum += last;
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  if (sum == 42)
+    std::cout << "";
+  return lookups / elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  U64 lookups = 100000000;
+  if (argc > 1)
+    lookups = std::strtoull(argv[1], nullptr, 10);
+
+  std::array<Wyvern::MagicBB, 64> bishops;
+  std::array<Wyvern::MagicBB, 64> rooks;
+  if (!Wyvern::initialiseAllMagics(bishops, rooks))
+    return 1;
+  auto mt = std::make_unique<Wyvern::MagicTable>();
+
+  // sparse occupancies, roughly as in a middlegame
+  std::vector<Query> queries(1 << 16);
+  U64 state = 1;
+  for (Query& q : queries)
+  {
+    q.sq = splitmix(state) & 63;
+    q.occ = splitmix(state) & splitmix(state);
+  }
+
+  auto per_square = [&](int sq, U64 occ)
+  { return bishops[sq].compute(occ) | rooks[sq].compute(occ); };
+  auto contiguous = [&](int sq, U64 occ) { return mt->attacks<Wyvern::QUEEN>(sq, occ); };
+  for (bool dependent : {false, true})
+  {
+    const char* mode = dependent ? "dependent" : "independent";
+    std::cout << "MagicBB::compute    " << mode << " "
+              << static_cast<U64>(lookupsPerSec(queries, lookups, dependent, per_square) / 1e6)
+              << "M queen lookups/sec" << std::endl;
+    std::cout << "MagicTable::attacks " << mode << " "
+              << static_cast<U64>(lookupsPerSec(queries, lookups, dependent, contiguous) / 1e6)
+              << "M queen lookups/sec" << std::endl;
+  }
+  return 0;
+}
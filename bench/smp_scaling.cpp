@@ -0,0 +1,48 @@
+#include "position.h"
+#include "search.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+// nodes/sec of Search::bestmove from 1 up to N lazy smp threads.
+// usage: wyvern_bench_smp [max_threads] [seconds]
+
+namespace
+{
+
+constexpr char middlegame_fen[] = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R";
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  int max_threads = static_cast<int>(std::thread::hardware_concurrency());
+  double seconds = 3;
+  if (argc > 1)
+    max_threads = std::atoi(argv[1]);
+  if (argc > 2)
+    seconds = std::atof(argv[2]);
+  if (max_threads < 1)
+    max_threads = 1;
+
+  double base_nps = 0;
+  for (int threads = 1; threads <= max_threads; threads++)
+  {
+    Wyvern::Search search;
+    search.setThreads(threads);
+    Wyvern::Position position(middlegame_fen);
+    int eval = 0;
+    auto start = std::chrono::steady_clock::now();
+    search.bestmove(position, seconds, 64, 64, eval);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double nps = search.getNodeCount() / elapsed.count();
+    if (threads == 1)
+      base_nps = nps;
+    std::cout << "threads=" << threads << " nodes=" << search.getNodeCount()
+              << " time=" << elapsed.count() << "s nps=" << static_cast<U64>(nps)
+              << " scaling=" << nps / base_nps << std::endl;
+  }
+  return 0;
+}
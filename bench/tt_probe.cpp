@@ -0,0 +1,62 @@
+#include "transposition.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+// transposition table probe latency with and without transparent huge pages.
+// each probe key depends on the previous result so the probes cannot overlap.
+// usage: wyvern_bench_tt [mb] [probes]
+
+namespace
+{
+
+U64 splitmix(U64& state)
+{
+  U64 z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+double probeLatency(size_t mb, bool huge_pages, U64 probes, bool& got_huge_pages)
+{
+  Wyvern::TranspositionTable table;
+  table.resize(mb, huge_pages);
+  got_huge_pages = table.usesHugePages();
+  U64 fill = static_cast<U64>(mb) * 1024 * 1024 / 16;
+  U64 state = 1;
+  for (U64 i = 0; i < fill; i++)
+    table.insert(splitmix(state), Wyvern::BoundedEval(Wyvern::BOUND_EXACT, i & 1023), 1);
+
+  state = 2;
+  int chain = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (U64 i = 0; i < probes; i++)
+    chain += table.lookup(splitmix(state) + (chain & 1), 0).eval;
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  if (chain == 42)
+    std::cout << "";
+  return elapsed.count() / probes;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  size_t mb = 1024;
+  U64 probes = 20000000;
+  if (argc > 1)
+    mb = std::strtoull(argv[1], nullptr, 10);
+  if (argc > 2)
+    probes = std::strtoull(argv[2], nullptr, 10);
+
+  for (bool huge_pages : {false, true})
+  {
+    bool got_huge_pages = false;
+    double ns = probeLatency(mb, huge_pages, probes, got_huge_pages);
+    std::cout << "table=" << mb << "MB huge_pages=" << (got_huge_pages ? "yes" : "no")
+              << " probe=" << ns << "ns" << std::endl;
+  }
+  return 0;
+}
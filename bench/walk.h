@@ -0,0 +1,43 @@
+#pragma once
+
+#include "movegen.h"
+#include "position.h"
+
+// move generation helpers shared by the benchmarks
+
+namespace Bench
+{
+
+// the legal moves of the side to move
+inline void generateMoves(Wyvern::MoveGenerator& movegen, Wyvern::Position& pos,
+                          Wyvern::MoveList& moves)
+{
+  if (pos.getToMove() == Wyvern::COLOR_WHITE)
+    movegen.generateMoves<Wyvern::COLOR_WHITE>(pos, true, moves);
+  else
+    movegen.generateMoves<Wyvern::COLOR_BLACK>(pos, true, moves);
+}
+
+// walks every line to depth with make and unmake and calls leaf on each
+// position at the end of one; returns the number of leaves
+template <typename F>
+U64 walk(Wyvern::MoveGenerator& movegen, Wyvern::Position& pos, int depth, F&& leaf)
+{
+  if (depth == 0)
+  {
+    leaf(pos);
+    return 1;
+  }
+  Wyvern::MoveList moves;
+  generateMoves(movegen, pos, moves);
+  U64 leaves = 0;
+  for (U32 move : moves)
+  {
+    pos.makeMove(move);
+    leaves += walk(movegen, pos, depth - 1, leaf);
+    pos.unmakeMove();
+  }
+  return leaves;
+}
+
+} // namespace Bench
@@ -0,0 +1,53 @@
+#include "evalcache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+
+namespace Wyvern
+{
+
+constexpr U64 key_mask = 0xFFFFFFFF00000000ULL;
+
+bool EvalCache::lookup(U64 key, int& eval)
+{
+  if (table.empty())
+    return false;
+  U64& slot = table[key & (table.size() - 1)];
+  U64 entry = std::atomic_ref<U64>(slot).load(std::memory_order_relaxed);
+  if ((entry & key_mask) != (key & key_mask))
+    return false;
+  eval = static_cast<int>(static_cast<U32>(entry));
+  return true;
+}
+
+void EvalCache::insert(U64 key, int eval)
+{
+  if (table.empty())
+    return;
+  U64 entry = (key & key_mask) | static_cast<U32>(eval);
+  std::atomic_ref<U64>(table[key & (table.size() - 1)]).store(entry, std::memory_order_relaxed);
+}
+
+void EvalCache::resize(size_t kb)
+{
+  size_t entries = kb * 1024 / sizeof(U64);
+  table.assign(entries ? std::bit_floor(entries) : 0, 0);
+}
+
+void EvalCache::clear()
+{
+  std::fill(table.begin(), table.end(), 0);
+}
+
+size_t EvalCache::sizeKB() const
+{
+  return table.size() * sizeof(U64) / 1024;
+}
+
+EvalCache::EvalCache(size_t kb)
+{
+  resize(kb);
+}
+
+} // namespace Wyvern
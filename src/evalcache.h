@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "types.h"
+
+namespace Wyvern
+{
+
+// static evaluations keyed by zobrist key, shared by all search threads. each
+// entry is one word: the high half of the key above the eval. entries are
+// read and written with relaxed atomics and no locks, so a probe always sees a
+// whole entry, and the low half of the key is implied by the slot. entries are
+// always replaced. a default constructed cache is empty and caches nothing.
+class EvalCache
+{
+private:
+  std::vector<U64> table;
+
+public:
+  bool lookup(U64 key, int& eval);
+  void insert(U64 key, int eval);
+
+  // resizes to the largest power of two number of entries that fits in kb
+  // kilobytes, and clears it. must not be called while a search is running.
+  void resize(size_t kb);
+  void clear();
+  size_t sizeKB() const;
+
+  EvalCache() = default;
+  explicit EvalCache(size_t kb);
+};
+
+} // namespace Wyvern
@@ -1,50 +1,16 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <bit>
+#include <stdexcept>
+#include <thread>
 
 #include "evaluate.h"
+#include "simd.h"
 
 namespace Wyvern
 {
 
-constexpr int place_value_pawn[64] = {
-  0,  0,  0,  0,  0,  0,  0,  0,  5,  10, 10, -20, -20, 10, 10, 5,  5, -5, -5, 0,  0,  -10,
-  -5, 5,  0,  0,  5,  20, 20, 0,  0,  0,  5,  5,   10,  25, 25, 10, 5, 5,  10, 10, 20, 30,
-  30, 20, 10, 10, 50, 50, 50, 50, 50, 50, 50, 50,  0,   0,  0,  0,  0, 0,  0,  0};
-
-constexpr int place_value_knight[64] = {
-  -50, -40, -30, -30, -30, -30, -40, -50, -40, -20, 0,   0,   0,   0,   -20, -40,
-  -30, 5,   10,  15,  15,  10,  5,   -30, -30, 0,   15,  20,  20,  15,  0,   -30,
-  -30, 5,   15,  20,  20,  15,  5,   -30, -30, 0,   10,  15,  15,  10,  0,   -30,
-  -40, -20, 0,   5,   5,   0,   -20, -40, -50, -40, -30, -30, -30, -30, -40, -50};
-
-constexpr int place_value_bishop[64] = {
-  -20, -10, -10, -10, -10, -10, -10, -20, -10, 0,   0,   0,   0,   0,   0,   -10,
-  -10, 10,  10,  10,  10,  10,  10,  -10, -10, 0,   10,  10,  10,  10,  0,   -10,
-  -10, 5,   5,   10,  10,  5,   5,   -10, -10, 0,   5,   10,  10,  5,   0,   -10,
-  -10, 5,   0,   0,   0,   0,   5,   -10, -20, -10, -10, -10, -10, -10, -10, -20};
-
-constexpr int place_value_rook[64] = {0,  0,  0,  5,  5,  0,  0,  0,  -5, 0, 0, 0, 0, 0, 0, -5,
-                                      -5, 0,  0,  0,  0,  0,  0,  -5, -5, 0, 0, 0, 0, 0, 0, -5,
-                                      -5, 0,  0,  0,  0,  0,  0,  -5, -5, 0, 0, 0, 0, 0, 0, -5,
-                                      5,  10, 10, 10, 10, 10, 10, 5,  0,  0, 0, 0, 0, 0, 0, 0};
-
-constexpr int place_value_queen[64] = {-20, -10, -10, -5,  -5,  -10, -10, -20, -10, 0,   5,   0,  0,
-                                       0,   0,   -10, -10, 5,   5,   5,   5,   5,   0,   -10, 0,  0,
-                                       5,   5,   5,   5,   0,   -5,  -5,  0,   5,   5,   5,   5,  0,
-                                       -5,  -10, 0,   5,   5,   5,   5,   0,   -10, -10, 0,   0,  0,
-                                       0,   0,   0,   -10, -20, -10, -10, -5,  -5,  -10, -10, -20};
-
-constexpr int king_middle_game[64] = {
-  20,  30,  10,  0,   0,   10,  30,  20,  20,  20,  0,   0,   0,   0,   20,  20,
-  -10, -20, -20, -20, -20, -20, -20, -10, -20, -30, -30, -40, -40, -30, -30, -20,
-  -30, -40, -40, -50, -50, -40, -40, -30, -30, -40, -40, -50, -50, -40, -40, -30,
-  -30, -40, -40, -50, -50, -40, -40, -30, -30, -40, -40, -50, -50, -40, -40, -30};
-
-constexpr int king_end_game[64] = {-50, -30, -30, -30, -30, -30, -30, -50, -30, -30, 0,   0,   0,
-                                   0,   -30, -30, -30, -10, 20,  30,  30,  20,  -10, -30, -30, -10,
-                                   30,  40,  40,  30,  -10, -30, -30, -10, 30,  40,  40,  30,  -10,
-                                   -30, -30, -10, 20,  30,  30,  20,  -10, -30, -30, -20, -10, 0,
-                                   0,   -10, -20, -30, -50, -40, -30, -20, -20, -30, -40, -50};
-
 constexpr int passed_pawn_value = 50;
 
 constexpr int queen_mobility_factor = 3;
@@ -55,171 +21,361 @@ constexpr U64 central_squares =
   (FILE_C | FILE_D | FILE_E | FILE_F) & (RANK_3 | RANK_4 | RANK_5 | RANK_6);
 constexpr U64 side_territory[2] = {0xFFFFFFFFULL, 0xFFFFFFFF00000000ULL};
 constexpr int space_value = 2;
+constexpr int eg_mg_diff = midgame_material_limit - endgame_material_limit;
+
+#if defined(WYVERN_SIMD_AVX2)
+namespace
+{
 
-int psqvTableLookup(enum Color ct, int p, const int* table)
+template <int S> WYVERN_TARGET_AVX2 inline __m256i shift(__m256i v)
 {
-  if (ct == COLOR_WHITE)
-    return table[p];
+  if constexpr (S > 0)
+    return _mm256_slli_epi64(v, S);
   else
-    return table[(p & 7) + 56 - (p & 56)];
+    return _mm256_srli_epi64(v, -S);
 }
 
-int Evaluator::evalMaterialOnly(Position const& pos)
+// kogge-stone occluded fill in direction S from each lane's piece; wrap masks
+// off squares a shift in S would wrap onto
+template <int S> WYVERN_TARGET_AVX2 inline __m256i slide(__m256i gen, __m256i empty, U64 wrap)
 {
-  enum Color player = pos.getToMove();
-  enum Color opponent = (player == COLOR_BLACK) ? COLOR_WHITE : COLOR_BLACK;
-  const U64* pcols = pos.getPieceColors();
-  const U64* pcs = pos.getPieces();
+  const __m256i wrap_v = _mm256_set1_epi64x(static_cast<long long>(wrap));
+  __m256i pro = _mm256_and_si256(empty, wrap_v);
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, shift<S>(gen)));
+  pro = _mm256_and_si256(pro, shift<S>(pro));
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, shift<2 * S>(gen)));
+  pro = _mm256_and_si256(pro, shift<2 * S>(pro));
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, shift<4 * S>(gen)));
+  return _mm256_and_si256(shift<S>(gen), wrap_v);
+}
+
+// attacks of four pieces at once, one per lane: diagonal slides where diag is
+// set, orthogonal where orth is, knight jumps where knight is
+WYVERN_TARGET_AVX2 inline __m256i attacksAvx2(__m256i p, __m256i diag, __m256i orth,
+                                              __m256i knight, __m256i empty)
+{
+  constexpr U64 all = ~0ULL;
+  // rays that step east, then those that step west
+  __m256i ne = _mm256_or_si256(slide<9>(p, empty, ~FILE_A), slide<-7>(p, empty, ~FILE_A));
+  __m256i nw = _mm256_or_si256(slide<7>(p, empty, ~FILE_H), slide<-9>(p, empty, ~FILE_H));
+  __m256i d = _mm256_or_si256(ne, nw);
+  __m256i ns = _mm256_or_si256(slide<8>(p, empty, all), slide<-8>(p, empty, all));
+  __m256i ew = _mm256_or_si256(slide<1>(p, empty, ~FILE_A), slide<-1>(p, empty, ~FILE_H));
+  __m256i o = _mm256_or_si256(ns, ew);
+
+  const __m256i not_a = _mm256_set1_epi64x(static_cast<long long>(~FILE_A));
+  const __m256i not_h = _mm256_set1_epi64x(static_cast<long long>(~FILE_H));
+  const __m256i not_ab = _mm256_set1_epi64x(static_cast<long long>(~(FILE_A | FILE_B)));
+  const __m256i not_gh = _mm256_set1_epi64x(static_cast<long long>(~(FILE_G | FILE_H)));
+  __m256i h1 = _mm256_or_si256(_mm256_and_si256(shift<-1>(p), not_h),
+                               _mm256_and_si256(shift<1>(p), not_a));
+  __m256i h2 = _mm256_or_si256(_mm256_and_si256(shift<-2>(p), not_gh),
+                               _mm256_and_si256(shift<2>(p), not_ab));
+  __m256i n = _mm256_or_si256(_mm256_or_si256(shift<16>(h1), shift<-16>(h1)),
+                              _mm256_or_si256(shift<8>(h2), shift<-8>(h2)));
+
+  return _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(d, diag), _mm256_and_si256(o, orth)),
+                         _mm256_and_si256(n, knight));
+}
+
+// the mobility terms of one group of up to four pieces, lanes past the last
+// piece being left empty
+struct MobilityGroup
+{
+  alignas(32) U64 pieces[4];
+  alignas(32) U64 diag[4];
+  alignas(32) U64 orth[4];
+  alignas(32) U64 knight[4];
+  int factor[4];
+  int lanes = 0;
+};
+
+WYVERN_TARGET_AVX2 int groupMobility(MobilityGroup& group, __m256i empty, U64 unsafe, int interp)
+{
+  for (int lane = group.lanes; lane < 4; lane++)
+    group.pieces[lane] = 0;
+  alignas(32) U64 attacks[4];
+  __m256i att = attacksAvx2(_mm256_load_si256(reinterpret_cast<const __m256i*>(group.pieces)),
+                            _mm256_load_si256(reinterpret_cast<const __m256i*>(group.diag)),
+                            _mm256_load_si256(reinterpret_cast<const __m256i*>(group.orth)),
+                            _mm256_load_si256(reinterpret_cast<const __m256i*>(group.knight)),
+                            empty);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(attacks), att);
+  int total = 0;
+  for (int lane = 0; lane < group.lanes; lane++)
+    total += (std::popcount(attacks[lane] & ~unsafe) * group.factor[lane] * interp) / eg_mg_diff;
+  group.lanes = 0;
+  return total;
+}
+
+// Evaluator::mobility for the side's pieces, four to a register
+WYVERN_TARGET_AVX2 int mobilityAvx2(const U64* pcs, U64 side, U64 occ, U64 unsafe, int interp)
+{
+  constexpr int factors[4] = {knight_mobility_factor, bishop_mobility_factor,
+                              rook_mobility_factor, queen_mobility_factor};
+  const __m256i empty = _mm256_set1_epi64x(static_cast<long long>(~occ));
+  MobilityGroup group;
   int total = 0;
-  for (int i = 0; i < 5; ++i)
+  for (int pt = KNIGHT - 1; pt <= QUEEN - 1; pt++)
   {
-    total += pvals[i] * std::popcount(pcols[player] & pcs[i]);
-    total -= pvals[i] * std::popcount(pcols[opponent] & pcs[i]);
+    const U64 is_diag = (pt == BISHOP - 1 || pt == QUEEN - 1) ? ~0ULL : 0;
+    const U64 is_orth = (pt == ROOK - 1 || pt == QUEEN - 1) ? ~0ULL : 0;
+    const U64 is_knight = (pt == KNIGHT - 1) ? ~0ULL : 0;
+    for (U64 ps = pcs[pt] & side; ps; ps &= ps - 1)
+    {
+      const int lane = group.lanes++;
+      group.pieces[lane] = ps & -ps;
+      group.diag[lane] = is_diag;
+      group.orth[lane] = is_orth;
+      group.knight[lane] = is_knight;
+      group.factor[lane] = factors[pt - (KNIGHT - 1)];
+      if (group.lanes == 4)
+        total += groupMobility(group, empty, unsafe, interp);
+    }
   }
-  // total += (int) (rand() % 101) - 50;
+  if (group.lanes)
+    total += groupMobility(group, empty, unsafe, interp);
   return total;
 }
 
+} // namespace
+#endif
+
+int Evaluator::evalMaterialOnly(Position const& pos)
+{
+  enum Color player = pos.getToMove();
+  const PsqtScores& scores = pos.getScores();
+  return scores.material[player] - scores.material[player ^ 1];
+}
+
 int Evaluator::totalMaterial(Position const& pos)
 {
-  const U64* pcs = pos.getPieces();
-  int total_material = 0;
-  total_material += std::popcount(pcs[PAWN - 1]);
-  total_material += 3 * std::popcount(pcs[KNIGHT - 1] | pcs[BISHOP - 1]);
-  total_material += 5 * std::popcount(pcs[ROOK - 1]);
-  total_material += 9 * std::popcount(pcs[QUEEN - 1]);
-  return total_material;
+  return pos.getScores().phase;
 }
 
 int Evaluator::evalPositional(Position const& pos)
 {
+  if (network)
+    return evalNnue(pos);
   enum Color player = pos.getToMove();
   enum Color opponent = (player == COLOR_BLACK) ? COLOR_WHITE : COLOR_BLACK;
   const U64* pcols = pos.getPieceColors();
   const U64* pcs = pos.getPieces();
+  const PsqtScores& scores = pos.getScores();
   int total = 0;
-  int total_material = totalMaterial(pos);
-  total_material += std::popcount(pcs[PAWN - 1]);
-  total_material += 3 * std::popcount(pcs[KNIGHT - 1] | pcs[BISHOP - 1]);
-  total_material += 5 * std::popcount(pcs[ROOK - 1]);
-  total_material += 9 * std::popcount(pcs[QUEEN - 1]);
-
-  constexpr int eg_mg_diff = midgame_material_limit - endgame_material_limit;
+  int total_material = scores.phase;
 
   U64 bb_blockers = (pcols[opponent] | pcols[player]);
-  U64 pawns_black = pcols[1] & pcs[PAWN - 1];
-  U64 pawns_white = pcols[0] & pcs[PAWN - 1];
-  U64 our_pawn_cs = (player) ? (pawns_black >> 7 & ~FILE_A) | (pawns_black >> 9 & ~FILE_H)
-                             : (pawns_white << 7 & ~FILE_H) | (pawns_white << 9 & ~FILE_A);
-  U64 opp_pawn_cs = (opponent) ? (pawns_black >> 7 & ~FILE_A) | (pawns_black >> 9 & ~FILE_H)
-                               : (pawns_white << 7 & ~FILE_H) | (pawns_white << 9 & ~FILE_A);
+  const PawnEntry& pawn_entry = probePawns(pos);
+  U64 our_pawn_cs = pawn_entry.attacks[player];
+  U64 opp_pawn_cs = pawn_entry.attacks[opponent];
+  total += (player == COLOR_WHITE) ? pawn_entry.score : -pawn_entry.score;
 
   int endgame_interp = (total_material <= endgame_material_limit) ? 0
                        : (total_material >= midgame_material_limit)
                          ? eg_mg_diff
                          : (eg_mg_diff * (total_material - endgame_material_limit)) / eg_mg_diff;
 
-  for (U64 pawns = pcs[PAWN - 1] & pcols[player]; pawns; pawns &= pawns - 1)
+  total += mobility(pcs, pcols[player], bb_blockers, opp_pawn_cs, endgame_interp);
+  total -= mobility(pcs, pcols[opponent], bb_blockers, our_pawn_cs, endgame_interp);
+
+  // piece-square values, with the king's blended between middle and end game
+  int psqt_mg = scores.middle_game[player] - scores.middle_game[opponent];
+  int psqt_eg = scores.end_game[player] - scores.end_game[opponent];
+  total += (endgame_interp * psqt_mg + (eg_mg_diff - endgame_interp) * psqt_eg) / eg_mg_diff;
+
+  total += scores.material[player] - scores.material[opponent];
+
+  total += 30; // 30 centipawns for side to move
+
+  return total;
+}
+
+void Evaluator::evaluateBatch(std::span<const Position> positions, std::span<int> evals,
+                              int threads)
+{
+  if (evals.size() < positions.size())
+    throw std::invalid_argument("evaluateBatch: evals is shorter than positions");
+  if (threads <= 0)
+    threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  size_t chunks = (positions.size() + eval_batch_chunk - 1) / eval_batch_chunk;
+  threads = std::clamp<int>(threads, 1, std::max<size_t>(chunks, 1));
+  std::atomic<size_t> next_chunk = 0;
+  auto work = [&](Evaluator& evaluator)
   {
-    int p = std::countr_zero(pawns);
-    total += psqvTableLookup(player, p, place_value_pawn);
-    if (!(mt->passed_pawns[p + 64 * player] & pcs[PAWN - 1] & pcols[opponent]))
-      total += passed_pawn_value;
-  }
-  for (U64 pawns = pcs[PAWN - 1] & pcols[opponent]; pawns; pawns &= pawns - 1)
+    for (size_t c = next_chunk++; c < chunks; c = next_chunk++)
+    {
+      size_t begin = c * eval_batch_chunk;
+      size_t count = std::min(eval_batch_chunk, positions.size() - begin);
+      evaluator.evaluateChunk(positions.subspan(begin, count), evals.subspan(begin, count));
+    }
+  };
+  std::vector<std::unique_ptr<Evaluator>> helpers;
+  std::vector<std::thread> workers;
+  for (int t = 1; t < threads; t++)
   {
-    int p = std::countr_zero(pawns);
-    total -= psqvTableLookup(opponent, p, place_value_pawn);
-    if (!(mt->passed_pawns[p + 64 * opponent] & pcs[PAWN - 1] & pcols[player]))
-      total -= passed_pawn_value;
+    helpers.push_back(std::make_unique<Evaluator>(mt));
+    helpers.back()->network = network;
+    helpers.back()->simd_mobility = simd_mobility;
+    workers.emplace_back(work, std::ref(*helpers.back()));
   }
+  work(*this);
+  for (auto& w : workers)
+    w.join();
+}
 
-  for (U64 knights = pcs[KNIGHT - 1] & pcols[player]; knights; knights &= knights - 1)
+// the pawn hash entries of a block of positions are prefetched before any of
+// them is evaluated, so that their misses overlap
+void Evaluator::evaluateChunk(std::span<const Position> positions, std::span<int> evals)
+{
+  constexpr size_t block = 64;
+  if (pawn_table.empty())
+    pawn_table.resize(pawn_hash_entries);
+  for (size_t begin = 0; begin < positions.size(); begin += block)
   {
-    int p = std::countr_zero(knights);
-    total += psqvTableLookup(player, p, place_value_knight);
-    U64 targets = mt->knight_table[p] & ~opp_pawn_cs;
-    total += (std::popcount(targets) * knight_mobility_factor * endgame_interp) / eg_mg_diff;
+    size_t end = std::min(begin + block, positions.size());
+    if (!network)
+    {
+      for (size_t i = begin; i < end; i++)
+        WYVERN_PREFETCH(&pawn_table[positions[i].getPawnKey() & (pawn_hash_entries - 1)]);
+    }
+    for (size_t i = begin; i < end; i++)
+      evals[i] = evalPositional(positions[i]);
   }
-  for (U64 knights = pcs[KNIGHT - 1] & pcols[opponent]; knights; knights &= knights - 1)
+}
+
+const PawnEntry& Evaluator::probePawns(Position const& pos)
+{
+  // allocated on first use so that creating a Search stays cheap
+  if (pawn_table.empty())
+    pawn_table.resize(pawn_hash_entries);
+  U64 key = pos.getPawnKey();
+  PawnEntry& entry = pawn_table[key & (pawn_hash_entries - 1)];
+  pawn_probes++;
+  if (entry.key == key)
   {
-    int p = std::countr_zero(knights);
-    total -= psqvTableLookup(opponent, p, place_value_knight);
-    U64 targets = mt->knight_table[p] & ~our_pawn_cs;
-    total -= (std::popcount(targets) * knight_mobility_factor * endgame_interp) / eg_mg_diff;
+    pawn_hits++;
+    return entry;
   }
-
-  for (U64 bishops = pcs[BISHOP - 1] & pcols[player]; bishops; bishops &= bishops - 1)
+  const U64* pcols = pos.getPieceColors();
+  const U64* pcs = pos.getPieces();
+  U64 pawns_white = pcols[COLOR_WHITE] & pcs[PAWN - 1];
+  U64 pawns_black = pcols[COLOR_BLACK] & pcs[PAWN - 1];
+  entry.key = key;
+  entry.attacks[COLOR_WHITE] = (pawns_white << 7 & ~FILE_H) | (pawns_white << 9 & ~FILE_A);
+  entry.attacks[COLOR_BLACK] = (pawns_black >> 7 & ~FILE_A) | (pawns_black >> 9 & ~FILE_H);
+  entry.score = 0;
+
+  // passed pawns
+  for (U64 pawns = pawns_white; pawns; pawns &= pawns - 1)
   {
-    int p = std::countr_zero(bishops);
-    total += psqvTableLookup(player, p, place_value_bishop);
-    U64 targets = mt->bishop_magics[p].compute(bb_blockers) & ~opp_pawn_cs;
-    total += (std::popcount(targets) * bishop_mobility_factor * endgame_interp) / eg_mg_diff;
+    if (!(mt->passed_pawns[std::countr_zero(pawns)] & pawns_black))
+      entry.score += passed_pawn_value;
   }
-  for (U64 bishops = pcs[BISHOP - 1] & pcols[opponent]; bishops; bishops &= bishops - 1)
+  for (U64 pawns = pawns_black; pawns; pawns &= pawns - 1)
   {
-    int p = std::countr_zero(bishops);
-    total -= psqvTableLookup(opponent, p, place_value_bishop);
-    U64 targets = mt->bishop_magics[p].compute(bb_blockers) & ~our_pawn_cs;
-    total -= (std::popcount(targets) * bishop_mobility_factor * endgame_interp) / eg_mg_diff;
+    if (!(mt->passed_pawns[std::countr_zero(pawns) + 64] & pawns_white))
+      entry.score -= passed_pawn_value;
   }
 
-  for (U64 rooks = pcs[ROOK - 1] & pcols[player]; rooks; rooks &= rooks - 1)
+  // space
+  entry.score += std::popcount(entry.attacks[COLOR_WHITE] & central_squares &
+                               side_territory[COLOR_BLACK]) *
+                 space_value;
+  entry.score -= std::popcount(entry.attacks[COLOR_BLACK] & central_squares &
+                               side_territory[COLOR_WHITE]) *
+                 space_value;
+  return entry;
+}
+
+// the mobility of one side's knights, bishops, rooks and queens: for each, the
+// squares it attacks outside unsafe, scaled by its factor and by interp. every
+// piece's term is rounded on its own.
+int Evaluator::mobility(const U64* pcs, U64 side, U64 occ, U64 unsafe, int interp) const
+{
+#if defined(WYVERN_SIMD_AVX2)
+  if (simd_mobility)
+    return mobilityAvx2(pcs, side, occ, unsafe, interp);
+#endif
+  return mobilityScalar(pcs, side, occ, unsafe, interp);
+}
+
+int Evaluator::mobilityScalar(const U64* pcs, U64 side, U64 occ, U64 unsafe, int interp) const
+{
+  int total = 0;
+  for (U64 knights = pcs[KNIGHT - 1] & side; knights; knights &= knights - 1)
   {
-    int p = std::countr_zero(rooks);
-    total += psqvTableLookup(player, p, place_value_rook);
-    U64 targets = mt->rook_magics[p].compute(bb_blockers) & ~opp_pawn_cs;
-    total += (std::popcount(targets) * rook_mobility_factor * endgame_interp) / eg_mg_diff;
+    U64 targets = mt->knight_table[std::countr_zero(knights)] & ~unsafe;
+    total += (std::popcount(targets) * knight_mobility_factor * interp) / eg_mg_diff;
   }
-  for (U64 rooks = pcs[ROOK - 1] & pcols[opponent]; rooks; rooks &= rooks - 1)
+  for (U64 bishops = pcs[BISHOP - 1] & side; bishops; bishops &= bishops - 1)
   {
-    int p = std::countr_zero(rooks);
-    total -= psqvTableLookup(opponent, p, place_value_rook);
-    U64 targets = mt->rook_magics[p].compute(bb_blockers) & ~our_pawn_cs;
-    total -= (std::popcount(targets) * rook_mobility_factor * endgame_interp) / eg_mg_diff;
+    U64 targets = mt->attacks<BISHOP>(std::countr_zero(bishops), occ) & ~unsafe;
+    total += (std::popcount(targets) * bishop_mobility_factor * interp) / eg_mg_diff;
   }
-
-  for (U64 queens = pcs[QUEEN - 1] & pcols[player]; queens; queens &= queens - 1)
+  for (U64 rooks = pcs[ROOK - 1] & side; rooks; rooks &= rooks - 1)
   {
-    int p = std::countr_zero(queens);
-    total += psqvTableLookup(player, p, place_value_queen);
-    U64 targets =
-      (mt->rook_magics[p].compute(bb_blockers) | mt->bishop_magics[p].compute(bb_blockers)) &
-      ~opp_pawn_cs;
-    total += (std::popcount(targets) * queen_mobility_factor * endgame_interp) / eg_mg_diff;
+    U64 targets = mt->attacks<ROOK>(std::countr_zero(rooks), occ) & ~unsafe;
+    total += (std::popcount(targets) * rook_mobility_factor * interp) / eg_mg_diff;
   }
-  for (U64 queens = pcs[QUEEN - 1] & pcols[opponent]; queens; queens &= queens - 1)
+  for (U64 queens = pcs[QUEEN - 1] & side; queens; queens &= queens - 1)
   {
-    int p = std::countr_zero(queens);
-    total -= psqvTableLookup(opponent, p, place_value_queen);
-    U64 targets =
-      (mt->rook_magics[p].compute(bb_blockers) | mt->bishop_magics[p].compute(bb_blockers)) &
-      ~our_pawn_cs;
-    total -= (std::popcount(targets) * queen_mobility_factor * endgame_interp) / eg_mg_diff;
+    U64 targets = mt->attacks<QUEEN>(std::countr_zero(queens), occ) & ~unsafe;
+    total += (std::popcount(targets) * queen_mobility_factor * interp) / eg_mg_diff;
   }
+  return total;
+}
 
-  int myking = std::countr_zero(pcs[KING - 1] & pcols[player]);
-  int kvals = endgame_interp * psqvTableLookup(player, myking, king_middle_game);
-  kvals += (eg_mg_diff - endgame_interp) * psqvTableLookup(player, myking, king_end_game);
-  int opking = std::countr_zero(pcs[KING - 1] & pcols[opponent]);
-  kvals -= endgame_interp * psqvTableLookup(opponent, opking, king_middle_game);
-  kvals -= (eg_mg_diff - endgame_interp) * psqvTableLookup(opponent, opking, king_end_game);
-  total += kvals / eg_mg_diff;
+void Evaluator::setSimdMobility(bool enabled)
+{
+  simd_mobility = enabled && cpuHasAvx2();
+}
 
-  // space
-  total += std::popcount(our_pawn_cs & central_squares & side_territory[opponent]) * space_value;
-  total -= std::popcount(opp_pawn_cs & central_squares & side_territory[player]) * space_value;
+bool Evaluator::getSimdMobility() const
+{
+  return simd_mobility;
+}
 
-  total += evalMaterialOnly(pos);
+// incremental when the position keeps accumulators for this network, from
+// scratch otherwise
+int Evaluator::evalNnue(Position const& pos)
+{
+  if (pos.getNetwork() == network.get())
+    return network->evaluate(pos.getAccumulator(), pos.getToMove());
+  NnueAccumulator acc;
+  network->refresh(acc, pos.getPieces(), pos.getPieceColors());
+  return network->evaluate(acc, pos.getToMove());
+}
 
-  total += 30; // 30 centipawns for side to move
+void Evaluator::setNetwork(std::shared_ptr<const NnueNetwork> net)
+{
+  network = net;
+}
 
-  return total;
+std::shared_ptr<const NnueNetwork> Evaluator::getNetwork() const
+{
+  return network;
+}
+
+U64 Evaluator::getPawnHits() const
+{
+  return pawn_hits;
+}
+
+U64 Evaluator::getPawnProbes() const
+{
+  return pawn_probes;
+}
+
+void Evaluator::resetStats()
+{
+  pawn_hits = 0;
+  pawn_probes = 0;
 }
 
-Evaluator::Evaluator(std::shared_ptr<MagicTable> _mt)
+Evaluator::Evaluator(std::shared_ptr<const MagicTable> _mt) : simd_mobility(false)
 {
-  mt = std::shared_ptr<MagicTable>(_mt);
+  mt = std::shared_ptr<const MagicTable>(_mt);
 }
 
 static U64 see_lvp(U64 attadef, U64 side_pcs, const U64* pieceBB, enum PieceType& aPiece)
@@ -250,14 +406,14 @@ int Evaluator::see(Position const& pos, enum PieceType piece, enum PieceType tar
   U64 to_bb = 1ULL << tosq;
   U64 may_xray_diag = pcs[0] | pcs[2] | pcs[4]; // pawns, bishops, queens
   U64 may_xray_orth = pcs[3] | pcs[4];          // rooks, queens
-  U64 attadef = (mt->bishop_magics[tosq].compute(blockers) & (pcs[2] | pcs[4])) |
-                (mt->rook_magics[tosq].compute(blockers) & (pcs[3] | pcs[4])) |
+  U64 attadef = (mt->attacks<BISHOP>(tosq, blockers) & (pcs[2] | pcs[4])) |
+                (mt->attacks<ROOK>(tosq, blockers) & (pcs[3] | pcs[4])) |
                 (mt->knight_table[tosq] & pcs[1]) | (mt->king_table[tosq] & pcs[5]) |
                 ((pcs[0] & pcols[0]) & ((to_bb >> 7 & ~FILE_A) | (to_bb >> 9 & ~FILE_H))) |
                 ((pcs[0] & pcols[1]) & ((to_bb << 7 & ~FILE_H) | (to_bb << 9 & ~FILE_A)));
 
-  U64 ad_xray = (mt->bishop_magics[tosq].compute(blockers & ~attadef) & (pcs[2] | pcs[4])) |
-                (mt->rook_magics[tosq].compute(blockers & ~attadef) & (pcs[3] | pcs[4]));
+  U64 ad_xray = (mt->attacks<BISHOP>(tosq, blockers & ~attadef) & (pcs[2] | pcs[4])) |
+                (mt->attacks<ROOK>(tosq, blockers & ~attadef) & (pcs[3] | pcs[4]));
   ad_xray &= ~attadef;
   int d = 0;
   gain[d] = pvals[(int)target - 1];
@@ -275,13 +431,13 @@ int Evaluator::see(Position const& pos, enum PieceType piece, enum PieceType tar
     if (fromset & may_xray_orth)
     {
       attadef |=
-        mt->rook_magics[tosq].compute(blockers) & (pcs[3] | pcs[4]) & may_xray_orth & ad_xray;
+        mt->attacks<ROOK>(tosq, blockers) & (pcs[3] | pcs[4]) & may_xray_orth & ad_xray;
       ad_xray &= ~attadef;
     }
     if (fromset & may_xray_diag)
     {
       attadef |=
-        mt->bishop_magics[tosq].compute(blockers) & (pcs[2] | pcs[4]) & may_xray_diag & ad_xray;
+        mt->attacks<BISHOP>(tosq, blockers) & (pcs[2] | pcs[4]) & may_xray_diag & ad_xray;
       ad_xray &= ~attadef;
     }
     fromset = see_lvp(attadef, pcols[side], pcs, aPiece);
@@ -1,26 +1,33 @@
 #pragma once
 
 #include "magicbb.h"
+#include "nnue.h"
 #include "position.h"
+#include "psqt.h"
 #include "types.h"
 #include "utils.h"
 #include <memory>
+#include <span>
+#include <vector>
 
 namespace Wyvern
 {
 
-constexpr int pval_pawn = 100;
-constexpr int pval_knight = 315;
-constexpr int pval_bishop = 330;
-constexpr int pval_rook = 500;
-constexpr int pval_queen = 900;
-
-constexpr int pvals[6] = {pval_pawn, pval_knight, pval_bishop,
-                          pval_rook, pval_queen,  20000}; // king has absurd value for see
-
 constexpr int endgame_material_limit = 20;
 constexpr int midgame_material_limit = 46;
 
+constexpr size_t pawn_hash_entries = 1 << 13;
+// positions an evaluateBatch thread claims at a time
+constexpr size_t eval_batch_chunk = 1024;
+
+// pawn structure terms, which depend on the pawns alone
+struct PawnEntry
+{
+  U64 key = 0;
+  std::array<U64, 2> attacks = {}; // squares attacked by each colour's pawns
+  int score = 0;                   // from white's point of view
+};
+
 // evaluates position for player to move
 
 class Evaluator
@@ -28,16 +35,46 @@ class Evaluator
 private:
   // 0-63 for white, 64-127 for black
   // U64 bb_passed_pawns[128];
-  std::shared_ptr<MagicTable> mt;
+  std::shared_ptr<const MagicTable> mt;
+  // pawn hash, indexed by the low bits of the pawn key. each Evaluator has its
+  // own, so entries need no locking. a zeroed entry is correct for no pawns.
+  std::vector<PawnEntry> pawn_table;
+  U64 pawn_hits = 0;
+  U64 pawn_probes = 0;
+  const PawnEntry& probePawns(Position const& pos);
+  // when set, evalPositional is the network's evaluation
+  std::shared_ptr<const NnueNetwork> network;
+  int evalNnue(Position const& pos);
+  bool simd_mobility;
+  int mobility(const U64* pcs, U64 side, U64 occ, U64 unsafe, int interp) const;
+  int mobilityScalar(const U64* pcs, U64 side, U64 occ, U64 unsafe, int interp) const;
+  void evaluateChunk(std::span<const Position> positions, std::span<int> evals);
 
 public:
   Evaluator() = delete;
   int evalMaterialOnly(Position const& pos);
   int totalMaterial(Position const& pos);
   int evalPositional(Position const& pos);
-  Evaluator(std::shared_ptr<MagicTable> mt);
+  // evals[i] = evalPositional(positions[i]) for every position; throws
+  // std::invalid_argument if evals is shorter. batches longer than a chunk are
+  // shared out over up to threads threads, 0 meaning one per hardware thread;
+  // helpers get their own Evaluator with this one's settings, so their pawn
+  // hash hits are not counted
+  void evaluateBatch(std::span<const Position> positions, std::span<int> evals, int threads = 0);
+  Evaluator(std::shared_ptr<const MagicTable> mt);
   ~Evaluator() = default;
   Evaluator(Evaluator& evaluator) = delete;
+  U64 getPawnHits() const;
+  U64 getPawnProbes() const;
+  void resetStats();
+  // nullptr goes back to the hand written evaluation
+  void setNetwork(std::shared_ptr<const NnueNetwork> net);
+  std::shared_ptr<const NnueNetwork> getNetwork() const;
+  // mobility four pieces at a time with avx2 kogge-stone fills, ignored where
+  // the cpu lacks avx2. off by default: it gives the same evaluation, but the
+  // magic lookups of the scalar path are faster (wyvern_bench_eval_simd).
+  void setSimdMobility(bool enabled);
+  bool getSimdMobility() const;
 
   template <enum Color CT> int seeCapture(Position const& pos, U32 capture);
   int see(Position const& pos, enum PieceType piece, enum PieceType target, int frsq, int tosq,
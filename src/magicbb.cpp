@@ -10,9 +10,10 @@ namespace Wyvern
 {
 
 MagicTable::MagicTable()
-    : knight_table{}, king_table{}, bishop_magics{}, rook_magics{}, passed_pawns{}
+    : slider_magics{}, knight_table{}, king_table{}, passed_pawns{}, attack_table{}
 {
-  if (!initialiseAllMagics(bishop_magics, rook_magics))
+  U32 offset = 0;
+  if (!initialiseSliders<BISHOP>(offset) || !initialiseSliders<ROOK>(offset))
   {
     throw std::runtime_error("Magic bitboard initialisation failed");
   }
@@ -56,6 +57,12 @@ MagicTable::MagicTable()
   }
 }
 
+std::shared_ptr<const MagicTable> MagicTable::shared()
+{
+  static const std::shared_ptr<const MagicTable> table = std::make_shared<const MagicTable>();
+  return table;
+}
+
 MagicBB::MagicBB(int sq, U64 mg, U64 ms, int b)
 {
   square = sq;
@@ -73,41 +80,41 @@ U64 MagicBB::compute(U64 blockers)
   return table[blockers];
 }
 
-constexpr U64 rook_magic_numbers[64] = {
-  0x8080008118604002ULL, 0x4040100040002002ULL, 0x0080100018e00380ULL, 0x0100041002200900ULL,
-  0x0200020008100420ULL, 0x4100040002880100ULL, 0x0080008002000100ULL, 0x8100014028820300ULL,
-  0x0860802080004008ULL, 0x0112004081020024ULL, 0x1042002010408200ULL, 0x00410010000b0020ULL,
-  0x0020800800800400ULL, 0x0004808026000400ULL, 0x0820800100800200ULL, 0x0d43000a00a04900ULL,
-  0x4080818000400068ULL, 0x0020818040002005ULL, 0x00a0010018410020ULL, 0x8010004008040041ULL,
-  0x0028008008800400ULL, 0x0809010002080400ULL, 0x1040240048311230ULL, 0x0088020000d28425ULL,
-  0x1480004440002010ULL, 0x2020400440201000ULL, 0x2000200080100080ULL, 0x1400280280300080ULL,
-  0x4028002500181100ULL, 0x8040040080800200ULL, 0x0800020400108108ULL, 0x003041120004408cULL,
-  0x0080804008800020ULL, 0x4010002000400040ULL, 0x2000100080802000ULL, 0x8300810804801000ULL,
-  0x8011001205000800ULL, 0x0810800601800400ULL, 0x4301083214000150ULL, 0x204026458e001401ULL,
-  0x0040204000808000ULL, 0x8001008040010020ULL, 0x8410820820420010ULL, 0x1003001000090020ULL,
-  0x0804040008008080ULL, 0x0012000810020004ULL, 0x1000100200040208ULL, 0x430000a044020001ULL,
-  0x0280009023410300ULL, 0x00e0100040002240ULL, 0x0000200100401700ULL, 0x2244100408008080ULL,
-  0x0008000400801980ULL, 0x0002000810040200ULL, 0x8010100228810400ULL, 0x2000009044210200ULL,
-  0x4080008040102101ULL, 0x0040002080411d01ULL, 0x2005524060000901ULL, 0x0502001008400422ULL,
-  0x489a000810200402ULL, 0x0001004400080a13ULL, 0x4000011008020084ULL, 0x0026002114058042ULL};
-
-constexpr U64 bishop_magic_numbers[64] = {
-  0x0420c80100408202ULL, 0x1204311202260108ULL, 0x2008208102030000ULL, 0x00024081001000caULL,
-  0x0488484041002110ULL, 0x001a080c2c010018ULL, 0x00020a02a2400084ULL, 0x0440404400a01000ULL,
-  0x0008931041080080ULL, 0x0000200484108221ULL, 0x0080460802188000ULL, 0x4000090401080092ULL,
-  0x4000011040a00004ULL, 0x0020011048040504ULL, 0x2008008401084000ULL, 0x000102422a101a02ULL,
-  0x2040801082420404ULL, 0x8104900210440100ULL, 0x0202101012820109ULL, 0x0248090401409004ULL,
-  0x0044820404a00020ULL, 0x0040808110100100ULL, 0x0480a80100882000ULL, 0x184820208a011010ULL,
-  0x0110400206085200ULL, 0x0001050010104201ULL, 0x4008480070008010ULL, 0x8440040018410120ULL,
-  0x0041010000104000ULL, 0x4010004080241000ULL, 0x0001244082061040ULL, 0x0051060000288441ULL,
-  0x0002215410a05820ULL, 0x6000941020a0c220ULL, 0x00f2080100020201ULL, 0x8010020081180080ULL,
-  0x0940012060060080ULL, 0x0620008284290800ULL, 0x0008468100140900ULL, 0x418400aa01802100ULL,
-  0x4000882440015002ULL, 0x0000420220a11081ULL, 0x0401a26030000804ULL, 0x0002184208000084ULL,
-  0xa430820a0410c201ULL, 0x0640053805080180ULL, 0x4a04010a44100601ULL, 0x0010014901001021ULL,
-  0x0422411031300100ULL, 0x0824222110280000ULL, 0x8800020a0b340300ULL, 0x00a8000441109088ULL,
-  0x0404000861010208ULL, 0x0040112002042200ULL, 0x02141006480b00a0ULL, 0x2210108081004411ULL,
-  0x2010804070100803ULL, 0x7a0011010090ac31ULL, 0x0018005100880400ULL, 0x8010001081084805ULL,
-  0x400200021202020aULL, 0x04100342100a0221ULL, 0x0404408801010204ULL, 0x6360041408104012ULL};
+// fills each square's block of attack_table, checking that the magic maps
+// every blocker subset to an index whose attack set agrees with it
+template <enum PieceType PT> bool MagicTable::initialiseSliders(U32& offset)
+{
+  const U64* magic_numbers = (PT == BISHOP) ? bishop_magic_numbers : rook_magic_numbers;
+  const int* bits = (PT == BISHOP) ? magicBBits : magicRBits;
+  for (int sq = 0; sq < 64; sq++)
+  {
+    SliderMagic& m = slider_magics[sq + ((PT == ROOK) ? 64 : 0)];
+    m.mask = getPremask<PT>(sq);
+    m.magic = magic_numbers[sq];
+    m.offset = offset;
+    m.shift = 64 - bits[sq];
+    U64 blockers = 0;
+    do
+    {
+      U64 attacks = generateAttacks<PT>(sq, blockers);
+      U64& entry = attack_table[offset + m.index(blockers)];
+      if (entry && entry != attacks)
+      {
+        std::cout << ((PT == ROOK) ? "Rook" : "Bishop") << " magic initialisation failed"
+                  << std::endl;
+        return false;
+      }
+      entry = attacks;
+      blockers = (blockers - m.mask) & m.mask;
+    } while (blockers);
+#ifdef WYVERN_USE_PEXT
+    offset += 1U << std::popcount(m.mask);
+#else
+    offset += 1U << bits[sq];
+#endif
+  }
+  return true;
+}
 
 bool initialiseAllMagics(std::array<MagicBB, 64>& bishops, std::array<MagicBB, 64>& rooks)
 {
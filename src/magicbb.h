@@ -3,11 +3,17 @@
 #include <array>
 #include <bit>
 #include <iostream>
+#include <memory>
 #include <vector>
 
+#include "magic_numbers.h"
 #include "types.h"
 #include "utils.h"
 
+#ifdef WYVERN_USE_PEXT
+#include <immintrin.h>
+#endif
+
 #define MAGIC_MAX_TRIALS 0x10000000000ULL
 
 namespace Wyvern
@@ -41,7 +47,8 @@ public:
     // printbb(mask);
     table = std::vector<U64>(1 << bits, 0);
     U64 blockers = 0;
-    for (U64 i = 0; i < (1ULL << bits); i++)
+    // bits may be fewer than the mask bits, so walk the subsets of the mask
+    do
     {
       U64 attacks = generateAttacks<PT>(square, blockers);
       U64 index = (magicnum * blockers) >> (64 - bits);
@@ -52,25 +59,12 @@ public:
       else if (table[index] != attacks)
         return 1;
       blockers = (blockers - mask) & mask;
-    }
+    } while (blockers);
     // std::cout << std::endl << "================" << std::endl;
     return 0;
   } // returns 1 on failure
 };
 
-class MagicTable
-{
-public:
-  std::array<U64, 64> knight_table;
-  std::array<U64, 64> king_table;
-  std::array<MagicBB, 64> bishop_magics;
-  std::array<MagicBB, 64> rook_magics;
-  std::array<U64, 128> passed_pawns; // sq + color*64;
-  MagicTable();
-  ~MagicTable() = default;
-  MagicTable(const MagicTable& mt) = default;
-};
-
 template <enum PieceType PT> U64 generateAttacks(int p, U64 blockers)
 {
   if constexpr (PT == ROOK)
@@ -152,16 +146,7 @@ template <enum PieceType PT> U64 generateAttacks(int p, U64 blockers)
   return 0;
 }
 
-constexpr int magicRBits[64] = {12, 11, 11, 11, 11, 11, 11, 12, 11, 10, 10, 10, 10, 10, 10, 11,
-                                11, 10, 10, 10, 10, 10, 10, 11, 11, 10, 10, 10, 10, 10, 10, 11,
-                                11, 10, 10, 10, 10, 10, 10, 11, 11, 10, 10, 10, 10, 10, 10, 11,
-                                11, 10, 10, 10, 10, 10, 10, 11, 12, 11, 11, 11, 11, 11, 11, 12};
-
-constexpr int magicBBits[64] = {6, 5, 5, 5, 5, 5, 5, 6, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 7, 7, 7, 7,
-                                5, 5, 5, 5, 7, 9, 9, 7, 5, 5, 5, 5, 7, 9, 9, 7, 5, 5, 5, 5, 7, 7,
-                                7, 7, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 6, 5, 5, 5, 5, 5, 5, 6};
-
-template <enum PieceType PT> U64 getPremask(int p)
+template <enum PieceType PT> constexpr U64 getPremask(int p)
 {
   if (p >= 64 || p < 0)
     return 0;
@@ -194,33 +179,137 @@ template <enum PieceType PT> U64 getPremask(int p)
   return out; // we're only interested in sliders here
 }
 
+// per-square slider record: the relevant occupancy mask, the magic multiplier,
+// the right shift (64 - index bits) and the offset of the square's block in
+// the shared attack array
+struct alignas(32) SliderMagic
+{
+  U64 mask;
+  U64 magic;
+  U32 offset;
+  U32 shift;
+  // with pext the masked occupancy bits are packed straight into an index, so
+  // the magic and shift go unused and each block is 2^popcount(mask) long
+  U64 index(U64 occ) const
+  {
+#ifdef WYVERN_USE_PEXT
+    return _pext_u64(occ, mask);
+#else
+    return ((occ & mask) * magic) >> shift;
+#endif
+  }
+};
+
+#ifdef WYVERN_USE_PEXT
+constexpr const char* slider_backend = "pext";
+#else
+constexpr const char* slider_backend = "magic";
+#endif
+
+// the slider attack table holds one block per square for each of bishops and
+// rooks, sized by the magic index bits, or by the mask bits with pext
+constexpr int sliderTableSize()
+{
+  int size = 0;
+  for (int sq = 0; sq < 64; sq++)
+  {
+#ifdef WYVERN_USE_PEXT
+    size += 1 << std::popcount(getPremask<BISHOP>(sq));
+    size += 1 << std::popcount(getPremask<ROOK>(sq));
+#else
+    size += (1 << magicBBits[sq]) + (1 << magicRBits[sq]);
+#endif
+  }
+  return size;
+}
+
+class MagicTable
+{
+private:
+  // bishops in 0-63, rooks in 64-127
+  std::array<SliderMagic, 128> slider_magics;
+  template <enum PieceType PT> bool initialiseSliders(U32& offset);
+
+public:
+  std::array<U64, 64> knight_table;
+  std::array<U64, 64> king_table;
+  std::array<U64, 128> passed_pawns; // sq + color*64;
+  // attack sets for every slider, square and blocker subset, indexed through
+  // slider_magics. one block so that lookups never chase a per-square pointer
+  alignas(64) std::array<U64, sliderTableSize()> attack_table;
+  MagicTable();
+  ~MagicTable() = default;
+  MagicTable(const MagicTable& mt) = default;
+  // one table for the whole process, built on first use. it is never written
+  // after construction, so any number of threads may share it
+  static std::shared_ptr<const MagicTable> shared();
+  // attacks from sq for the given occupancy; occ is ignored for knights and
+  // kings
+  template <enum PieceType PT> U64 attacks(int sq, U64 occ) const
+  {
+    if constexpr (PT == BISHOP || PT == ROOK)
+    {
+      const SliderMagic& m = slider_magics[sq + ((PT == ROOK) ? 64 : 0)];
+      return attack_table[m.offset + m.index(occ)];
+    }
+    else if constexpr (PT == QUEEN)
+      return attacks<BISHOP>(sq, occ) | attacks<ROOK>(sq, occ);
+    else if constexpr (PT == KNIGHT)
+      return knight_table[sq];
+    else if constexpr (PT == KING)
+      return king_table[sq];
+    else
+      return 0;
+  }
+};
+
 bool initialiseAllMagics(std::array<MagicBB, 64>& bishops, std::array<MagicBB, 64>& rooks);
 
-template <enum PieceType PT> U64 findMagicNum(int p)
+// searches for a magic for square p that maps every blocker subset to one of
+// 2^bits slots without a destructive collision (subsets sharing a slot must
+// share their attack set). bits may be fewer than the mask bits. candidates
+// are sparse random numbers from the xorshift64* state rng; returns 0 if none
+// works within max_trials.
+template <enum PieceType PT>
+U64 findMagicNum(int p, int bits, U64& rng, U64 max_trials = MAGIC_MAX_TRIALS)
 {
   if constexpr (PT != ROOK && PT != BISHOP)
     return 0;
-  int bits = (PT == BISHOP) ? magicBBits[p] : magicRBits[p];
   U64 mask = getPremask<PT>(p);
-  for (U64 k = 0; k < MAGIC_MAX_TRIALS; ++k)
+  std::vector<U64> occupancy;
+  std::vector<U64> attacks;
+  U64 blockers = 0;
+  do
+  {
+    occupancy.push_back(blockers);
+    attacks.push_back(generateAttacks<PT>(p, blockers));
+    blockers = (blockers - mask) & mask;
+  } while (blockers);
+  // a slot is in use for this trial if its epoch matches, so nothing needs
+  // clearing between trials
+  std::vector<U64> table(1ULL << bits);
+  std::vector<U64> epoch(1ULL << bits, 0);
+  for (U64 k = 1; k <= max_trials; ++k)
   {
-    U64 magic = rand64() & rand64() & rand64();
+    U64 magic = xorshift64star(rng) & xorshift64star(rng) & xorshift64star(rng);
     if (std::popcount((magic * mask) & 0xFF00000000000000ULL) < 6)
       continue;
-    MagicBB mbb = MagicBB(p, magic, mask, bits);
-    if (!mbb.initialise<PT>())
+    bool found = true;
+    for (size_t i = 0; i < occupancy.size() && found; i++)
     {
-      // std::cout << "magic number " << p << " for " << ((PT == ROOK) ? " rook"
-      // : "bishop") << " found in " << k+1 << " tries" << "\n";
-      return magic;
+      U64 index = (occupancy[i] * magic) >> (64 - bits);
+      if (epoch[index] != k)
+      {
+        epoch[index] = k;
+        table[index] = attacks[i];
+      }
+      else if (table[index] != attacks[i])
+        found = false;
     }
+    if (found)
+      return magic;
   }
-  std::cout << "Failed to find magic number " << p << " for "
-            << ((PT == ROOK) ? "  rook" : "bishop") << "\n";
   return 0;
 }
 
-template U64 findMagicNum<ROOK>(int p);
-template U64 findMagicNum<BISHOP>(int p);
-
 } // namespace Wyvern
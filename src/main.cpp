@@ -1,22 +1,29 @@
 #include "position.h"
 #include "search.h"
+#include "uci.h"
+#include <cstdlib>
 #include <iostream>
+#include <string_view>
 
-const char kiwipete_fen[56] = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R";
-
-int main()
+// usage: wyvernchess, speaking uci on stdin and stdout
+//        wyvernchess perft <depth> [threads] [hash_mb] [fen]
+int main(int argc, char** argv)
 {
-  Wyvern::Search search;
-  Wyvern::Position position(kiwipete_fen);
-
-  int captures = 0;
-  int en_passant = 0;
-  int castles = 0;
-  int promotions = 0;
-  int checks = 0;
+  if (argc > 2 && std::string_view(argv[1]) == "perft")
+  {
+    Wyvern::Search search;
+    Wyvern::PerftOptions options;
+    options.divide = true;
+    if (argc > 3)
+      options.threads = std::atoi(argv[3]);
+    if (argc > 4)
+      options.hash_mb = std::atoi(argv[4]);
+    Wyvern::Position position = (argc > 5) ? Wyvern::Position(argv[5]) : Wyvern::Position();
+    search.perft(position, std::atoi(argv[2]), options);
+    return 0;
+  }
 
-  const U64 nodes =
-    search.perft(position, 3, &captures, &en_passant, &promotions, &castles, &checks);
-  std::cout << "WyvernChess smoke perft: " << nodes << " nodes at kiwipete depth 3\n";
+  Wyvern::Uci uci;
+  uci.loop(std::cin);
   return 0;
 }
@@ -16,20 +16,19 @@ U64 MoveGenerator::makePinmask(int p, U64 pp_d, U64 pp_o, U64 blockers, int king
   if (pp_d & p_bit)
   {
     U64 bl_m_p = blockers & ~p_bit;
-    U64 kattack_through_p = mt->bishop_magics[king].compute(bl_m_p);
+    U64 kattack_through_p = mt->attacks<BISHOP>(king, bl_m_p);
     // pinner can have at most 1 bit set because of math!
-    U64 pinner = mt->bishop_magics[p].compute(blockers) & kattack_through_p & (enemy_diag);
+    U64 pinner = mt->attacks<BISHOP>(p, blockers) & kattack_through_p & (enemy_diag);
     if (pinner)
       pinmask =
-        kattack_through_p & (mt->bishop_magics[std::countr_zero(pinner)].compute(bl_m_p) | pinner);
+        kattack_through_p & (mt->attacks<BISHOP>(std::countr_zero(pinner), bl_m_p) | pinner);
   }
   else if (pp_o & p_bit)
   {
-    U64 kattack_through_p = mt->rook_magics[king].compute(bl_m_p);
-    U64 pinner = mt->rook_magics[p].compute(blockers) & kattack_through_p & (enemy_orth);
+    U64 kattack_through_p = mt->attacks<ROOK>(king, bl_m_p);
+    U64 pinner = mt->attacks<ROOK>(p, blockers) & kattack_through_p & (enemy_orth);
     if (pinner)
-      pinmask =
-        kattack_through_p & (mt->rook_magics[std::countr_zero(pinner)].compute(bl_m_p) | pinner);
+      pinmask = kattack_through_p & (mt->attacks<ROOK>(std::countr_zero(pinner), bl_m_p) | pinner);
   }
   return pinmask;
 }
@@ -54,9 +53,9 @@ U64 MoveGenerator::inCheck(Position& pos)
     return squareAttackedBy<COLOR_BLACK>(myKing, pos, 0);
 }
 
-MoveGenerator::MoveGenerator(std::shared_ptr<MagicTable> _mt)
+MoveGenerator::MoveGenerator(std::shared_ptr<const MagicTable> _mt)
 {
-  mt = std::shared_ptr<MagicTable>(_mt);
+  mt = std::shared_ptr<const MagicTable>(_mt);
 }
 
 template U64 MoveGenerator::bbCastles<COLOR_BLACK>(Position& pos);
@@ -86,38 +85,28 @@ template U64 MoveGenerator::bbPseudoLegalMoves<ROOK, COLOR_BLACK>(int p, U64 pos
 template U64 MoveGenerator::bbPseudoLegalMoves<QUEEN, COLOR_BLACK>(int p, U64 postmask,
                                                                    U64 bb_blockers);
 
-template void MoveGenerator::generateStandardMoves<PAWN, COLOR_WHITE>(U64, U64, U64, int, U64, U64,
-                                                                      const U64*, U64, U64,
-                                                                      std::vector<U32>&);
-template void MoveGenerator::generateStandardMoves<KNIGHT, COLOR_WHITE>(U64, U64, U64, int, U64,
-                                                                        U64, const U64*, U64, U64,
-                                                                        std::vector<U32>&);
-template void MoveGenerator::generateStandardMoves<BISHOP, COLOR_WHITE>(U64, U64, U64, int, U64,
-                                                                        U64, const U64*, U64, U64,
-                                                                        std::vector<U32>&);
-template void MoveGenerator::generateStandardMoves<ROOK, COLOR_WHITE>(U64, U64, U64, int, U64, U64,
-                                                                      const U64*, U64, U64,
-                                                                      std::vector<U32>&);
-template void MoveGenerator::generateStandardMoves<QUEEN, COLOR_WHITE>(U64, U64, U64, int, U64, U64,
-                                                                       const U64*, U64, U64,
-                                                                       std::vector<U32>&);
-template void MoveGenerator::generateStandardMoves<PAWN, COLOR_BLACK>(U64, U64, U64, int, U64, U64,
-                                                                      const U64*, U64, U64,
-                                                                      std::vector<U32>&);
-template void MoveGenerator::generateStandardMoves<KNIGHT, COLOR_BLACK>(U64, U64, U64, int, U64,
-                                                                        U64, const U64*, U64, U64,
-                                                                        std::vector<U32>&);
-template void MoveGenerator::generateStandardMoves<BISHOP, COLOR_BLACK>(U64, U64, U64, int, U64,
-                                                                        U64, const U64*, U64, U64,
-                                                                        std::vector<U32>&);
-template void MoveGenerator::generateStandardMoves<ROOK, COLOR_BLACK>(U64, U64, U64, int, U64, U64,
-                                                                      const U64*, U64, U64,
-                                                                      std::vector<U32>&);
-template void MoveGenerator::generateStandardMoves<QUEEN, COLOR_BLACK>(U64, U64, U64, int, U64, U64,
-                                                                       const U64*, U64, U64,
-                                                                       std::vector<U32>&);
+template void MoveGenerator::generateStandardMoves<PAWN, COLOR_WHITE>(
+  U64, U64, U64, int, U64, U64, const U64*, const U8*, U64, U64, MoveList&);
+template void MoveGenerator::generateStandardMoves<KNIGHT, COLOR_WHITE>(
+  U64, U64, U64, int, U64, U64, const U64*, const U8*, U64, U64, MoveList&);
+template void MoveGenerator::generateStandardMoves<BISHOP, COLOR_WHITE>(
+  U64, U64, U64, int, U64, U64, const U64*, const U8*, U64, U64, MoveList&);
+template void MoveGenerator::generateStandardMoves<ROOK, COLOR_WHITE>(
+  U64, U64, U64, int, U64, U64, const U64*, const U8*, U64, U64, MoveList&);
+template void MoveGenerator::generateStandardMoves<QUEEN, COLOR_WHITE>(
+  U64, U64, U64, int, U64, U64, const U64*, const U8*, U64, U64, MoveList&);
+template void MoveGenerator::generateStandardMoves<PAWN, COLOR_BLACK>(
+  U64, U64, U64, int, U64, U64, const U64*, const U8*, U64, U64, MoveList&);
+template void MoveGenerator::generateStandardMoves<KNIGHT, COLOR_BLACK>(
+  U64, U64, U64, int, U64, U64, const U64*, const U8*, U64, U64, MoveList&);
+template void MoveGenerator::generateStandardMoves<BISHOP, COLOR_BLACK>(
+  U64, U64, U64, int, U64, U64, const U64*, const U8*, U64, U64, MoveList&);
+template void MoveGenerator::generateStandardMoves<ROOK, COLOR_BLACK>(
+  U64, U64, U64, int, U64, U64, const U64*, const U8*, U64, U64, MoveList&);
+template void MoveGenerator::generateStandardMoves<QUEEN, COLOR_BLACK>(
+  U64, U64, U64, int, U64, U64, const U64*, const U8*, U64, U64, MoveList&);
 
-template int MoveGenerator::generateMoves<COLOR_BLACK>(Position&, bool, std::vector<U32>&);
-template int MoveGenerator::generateMoves<COLOR_WHITE>(Position&, bool, std::vector<U32>&);
+template int MoveGenerator::generateMoves<COLOR_BLACK>(Position&, bool, MoveList&);
+template int MoveGenerator::generateMoves<COLOR_WHITE>(Position&, bool, MoveList&);
 
 } // namespace Wyvern
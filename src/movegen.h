@@ -2,9 +2,9 @@
 
 #include <bit>
 #include <memory>
-#include <vector>
 
 #include "magicbb.h"
+#include "movelist.h"
 #include "position.h"
 #include "types.h"
 
@@ -15,8 +15,8 @@ namespace Wyvern
 
 /*
 
-move generator is responsible for putting valid moves in a Position into a move
-vector<U32> in preference order. search can then pop these moves.
+move generator is responsible for putting valid moves in a Position into a
+MoveList in preference order. search can then pop these moves.
 */
 
 class MoveGenerator
@@ -29,38 +29,24 @@ private:
                   U64 enemy_orth);
   template <enum PieceType PT, enum Color CT>
   void generateStandardMoves(U64 ps, U64 checkmask, U64 blockers, int myking, U64 our_pieces,
-                             U64 enemy_pieces, const U64* all_pieces, U64 pp_o, U64 pp_d,
-                             std::vector<U32>& move_tgts);
+                             U64 enemy_pieces, const U64* all_pieces, const U8* board, U64 pp_o,
+                             U64 pp_d, MoveList& move_tgts);
+  // grouped by victim, pawns first: quiesce searches captures in this order.
+  // the victim comes from the bitboard scan; the mailbox board only feeds
+  // promotions here, and make/unmake in Position
   void emplaceCaptures(int p, enum PieceType pt, U64 enemy_pieces, const U64* all_pieces,
-                       U64 targets, std::vector<U32>& move_tgts)
+                       U64 targets, MoveList& move_tgts)
   {
-    for (U64 t = targets & enemy_pieces & all_pieces[0]; t; t &= t - 1)
+    for (U32 victim = PAWN; victim <= QUEEN; victim++)
     {
-      int tp = std::countr_zero(t);
-      move_tgts.emplace_back(p + (tp << 6) + CAPTURE_PAWN + ((U32)pt << 20));
-    }
-    for (U64 t = targets & enemy_pieces & all_pieces[1]; t; t &= t - 1)
-    {
-      int tp = std::countr_zero(t);
-      move_tgts.emplace_back(p + (tp << 6) + CAPTURE_KNIGHT + ((U32)pt << 20));
-    }
-    for (U64 t = targets & enemy_pieces & all_pieces[2]; t; t &= t - 1)
-    {
-      int tp = std::countr_zero(t);
-      move_tgts.emplace_back(p + (tp << 6) + CAPTURE_BISHOP + ((U32)pt << 20));
-    }
-    for (U64 t = targets & enemy_pieces & all_pieces[3]; t; t &= t - 1)
-    {
-      int tp = std::countr_zero(t);
-      move_tgts.emplace_back(p + (tp << 6) + CAPTURE_ROOK + ((U32)pt << 20));
-    }
-    for (U64 t = targets & enemy_pieces & all_pieces[4]; t; t &= t - 1)
-    {
-      int tp = std::countr_zero(t);
-      move_tgts.emplace_back(p + (tp << 6) + CAPTURE_QUEEN + ((U32)pt << 20));
+      for (U64 t = targets & enemy_pieces & all_pieces[victim - 1]; t; t &= t - 1)
+      {
+        int tp = std::countr_zero(t);
+        move_tgts.emplace_back(p + (tp << 6) + YES_CAPTURE + (victim << 17) + ((U32)pt << 20));
+      }
     }
   }
-  void emplaceNonCaptures(int p, enum PieceType pt, U64 targets, std::vector<U32>& move_tgts)
+  void emplaceNonCaptures(int p, enum PieceType pt, U64 targets, MoveList& move_tgts)
   {
     for (U64 t = targets; t; t &= t - 1)
     {
@@ -68,24 +54,13 @@ private:
       move_tgts.emplace_back(p + (tp << 6) + ((U32)pt << 20));
     }
   }
-  void emplacePromotions(int p, U64 enemy_pieces, const U64* all_pieces, U64 targets,
-                         std::vector<U32>& move_tgts)
+  void emplacePromotions(int p, const U8* board, U64 targets, MoveList& move_tgts)
   {
     for (U64 t = targets; t; t &= t - 1)
     {
       int tp = std::countr_zero(t);
-      enum MoveCapture cap = NO_CAPTURE;
-      U64 tbb = 1ULL << tp;
-      if (enemy_pieces & all_pieces[PAWN - 1] & tbb)
-        cap = CAPTURE_PAWN;
-      if (enemy_pieces & all_pieces[KNIGHT - 1] & tbb)
-        cap = CAPTURE_KNIGHT;
-      if (enemy_pieces & all_pieces[BISHOP - 1] & tbb)
-        cap = CAPTURE_BISHOP;
-      if (enemy_pieces & all_pieces[ROOK - 1] & tbb)
-        cap = CAPTURE_ROOK;
-      if (enemy_pieces & all_pieces[QUEEN - 1] & tbb)
-        cap = CAPTURE_QUEEN;
+      enum MoveCapture cap =
+        (board[tp]) ? (enum MoveCapture)(((U32)board[tp] << 17) | YES_CAPTURE) : NO_CAPTURE;
       for (U32 pp = 0; pp <= (3 << 12); pp += 1 << 12)
       {
         move_tgts.emplace_back(p + (tp << 6) + ((U32)cap) + PROMO + pp + MOVE_PAWN);
@@ -94,13 +69,13 @@ private:
   }
 
 public:
-  std::shared_ptr<MagicTable> mt;
+  std::shared_ptr<const MagicTable> mt;
   template <enum Color CT> U64 squareAttackedBy(int p, const Position& pos, U64 custom_blockers);
   MoveGenerator() = delete;
-  MoveGenerator(std::shared_ptr<MagicTable> _mt);
+  MoveGenerator(std::shared_ptr<const MagicTable> _mt);
   MoveGenerator(const MoveGenerator&) = delete;
   template <enum Color CT>
-  int generateMoves(Position& pos, bool incl_quiets, std::vector<U32>& move_tgts);
+  int generateMoves(Position& pos, bool incl_quiets, MoveList& move_tgts);
   U64 inCheck(Position& pos);
   ~MoveGenerator() = default;
 };
@@ -108,17 +83,8 @@ public:
 template <enum PieceType PT, enum Color CT>
 U64 MoveGenerator::bbPseudoLegalMoves(int p, U64 postmask, U64 bb_blockers)
 {
-  if constexpr (PT == KNIGHT)
-    return mt->knight_table[p] & postmask;
-  if constexpr (PT == BISHOP)
-    return mt->bishop_magics[p].compute(bb_blockers) & postmask;
-  if constexpr (PT == ROOK)
-    return mt->rook_magics[p].compute(bb_blockers) & postmask;
-  if constexpr (PT == KING)
-    return mt->king_table[p] & postmask;
-  if constexpr (PT == QUEEN)
-    return (mt->bishop_magics[p].compute(bb_blockers) | mt->rook_magics[p].compute(bb_blockers)) &
-           postmask;
+  if constexpr (PT >= KNIGHT && PT <= KING)
+    return mt->attacks<PT>(p, bb_blockers) & postmask;
   if constexpr (PT == PAWN)
   {
     if constexpr (CT == COLOR_WHITE)
@@ -176,10 +142,9 @@ U64 MoveGenerator::squareAttackedBy(int p, const Position& pos, U64 custom_block
   const U64* pcs = pos.getPieces();
   U64 blockers = (custom_blockers) ? custom_blockers : (pcols[0] | pcols[1]) & ~(1ULL << p);
   U64 attackers = 0;
-  attackers |= pcs[QUEEN - 1] &
-               (mt->bishop_magics[p].compute(blockers) | mt->rook_magics[p].compute(blockers));
-  attackers |= pcs[ROOK - 1] & (mt->rook_magics[p].compute(blockers));
-  attackers |= pcs[BISHOP - 1] & (mt->bishop_magics[p].compute(blockers));
+  attackers |= pcs[QUEEN - 1] & mt->attacks<QUEEN>(p, blockers);
+  attackers |= pcs[ROOK - 1] & (mt->attacks<ROOK>(p, blockers));
+  attackers |= pcs[BISHOP - 1] & (mt->attacks<BISHOP>(p, blockers));
   attackers |= pcs[KNIGHT - 1] & mt->knight_table[p];
   attackers |= pcs[KING - 1] & mt->king_table[p];
   if constexpr (CT == COLOR_WHITE)
@@ -198,7 +163,8 @@ U64 MoveGenerator::squareAttackedBy(int p, const Position& pos, U64 custom_block
 template <enum PieceType PT, enum Color CT>
 void MoveGenerator::generateStandardMoves(U64 ps, U64 checkmask, U64 blockers, int myking,
                                           U64 our_pieces, U64 enemy_pieces, const U64* all_pieces,
-                                          U64 pp_o, U64 pp_d, std::vector<U32>& move_tgts)
+                                          const U8* board, U64 pp_o, U64 pp_d,
+                                          MoveList& move_tgts)
 {
   for (; ps; ps &= ps - 1)
   {
@@ -213,7 +179,7 @@ void MoveGenerator::generateStandardMoves(U64 ps, U64 checkmask, U64 blockers, i
       U64 t_promotions = targets & promo_rank;
       U64 t_captures = targets & enemy_pieces & ~promo_rank;
       U64 t_non_caps = targets & ~enemy_pieces & ~promo_rank;
-      emplacePromotions(p, enemy_pieces, all_pieces, t_promotions, move_tgts);
+      emplacePromotions(p, board, t_promotions, move_tgts);
       emplaceCaptures(p, PAWN, enemy_pieces, all_pieces, t_captures, move_tgts);
       emplaceNonCaptures(p, PAWN, t_non_caps, move_tgts);
     }
@@ -229,9 +195,8 @@ void MoveGenerator::generateStandardMoves(U64 ps, U64 checkmask, U64 blockers, i
 }
 
 template <enum Color CT>
-int MoveGenerator::generateMoves(Position& pos, bool incl_quiets, std::vector<U32>& move_tgts)
+int MoveGenerator::generateMoves(Position& pos, bool incl_quiets, MoveList& move_tgts)
 {
-  move_tgts.reserve(32);
   constexpr enum Color CTO = (enum Color)(CT ^ 1);
   if constexpr (CT > 1)
     return 0;
@@ -262,13 +227,13 @@ int MoveGenerator::generateMoves(Position& pos, bool incl_quiets, std::vector<U3
       default:
         if ((king_file ^ king_rank) & checkers)
         {
-          checkmask = mt->rook_magics[std::countr_zero(checkers)].compute(blockers) &
-                      mt->rook_magics[myking].compute(blockers);
+          checkmask = mt->attacks<ROOK>(std::countr_zero(checkers), blockers) &
+                      mt->attacks<ROOK>(myking, blockers);
         }
         else
         {
-          checkmask = mt->bishop_magics[std::countr_zero(checkers)].compute(blockers) &
-                      mt->bishop_magics[myking].compute(blockers);
+          checkmask = mt->attacks<BISHOP>(std::countr_zero(checkers), blockers) &
+                      mt->attacks<BISHOP>(myking, blockers);
         }
     }
     checkmask |= checkers;
@@ -284,27 +249,28 @@ int MoveGenerator::generateMoves(Position& pos, bool incl_quiets, std::vector<U3
   // printbb(checkmask);
   if (checkmask)
   {
-    U64 pp_d = mt->bishop_magics[myking].compute(blockers);
-    U64 pp_o = mt->rook_magics[myking].compute(blockers);
+    U64 pp_d = mt->attacks<BISHOP>(myking, blockers);
+    U64 pp_o = mt->attacks<ROOK>(myking, blockers);
 
+    const U8* board = pos.getBoard();
     U64 promo_rank = checkmask & ((CT) ? RANK_1 : RANK_8);
     // move ordering:
     // pxq, pxr, px
     generateStandardMoves<PAWN, CT>(piece_colors[CT] & pieces[PAWN - 1], v_targets | promo_rank,
                                     blockers, myking, piece_colors[CT], piece_colors[CTO], pieces,
-                                    pp_o, pp_d, move_tgts);
+                                    board, pp_o, pp_d, move_tgts);
     generateStandardMoves<KNIGHT, CT>(piece_colors[CT] & pieces[KNIGHT - 1], v_targets, blockers,
-                                      myking, piece_colors[CT], piece_colors[CTO], pieces, pp_o,
-                                      pp_d, move_tgts);
+                                      myking, piece_colors[CT], piece_colors[CTO], pieces, board,
+                                      pp_o, pp_d, move_tgts);
     generateStandardMoves<BISHOP, CT>(piece_colors[CT] & pieces[BISHOP - 1], v_targets, blockers,
-                                      myking, piece_colors[CT], piece_colors[CTO], pieces, pp_o,
-                                      pp_d, move_tgts);
+                                      myking, piece_colors[CT], piece_colors[CTO], pieces, board,
+                                      pp_o, pp_d, move_tgts);
     generateStandardMoves<ROOK, CT>(piece_colors[CT] & pieces[ROOK - 1], v_targets, blockers,
-                                    myking, piece_colors[CT], piece_colors[CTO], pieces, pp_o, pp_d,
-                                    move_tgts);
+                                    myking, piece_colors[CT], piece_colors[CTO], pieces, board,
+                                    pp_o, pp_d, move_tgts);
     generateStandardMoves<QUEEN, CT>(piece_colors[CT] & pieces[QUEEN - 1], v_targets, blockers,
-                                     myking, piece_colors[CT], piece_colors[CTO], pieces, pp_o,
-                                     pp_d, move_tgts);
+                                     myking, piece_colors[CT], piece_colors[CTO], pieces, board,
+                                     pp_o, pp_d, move_tgts);
   }
   // king moves
   U64 pseudo_king_moves = bbPseudoLegalMoves<KING, CT>(myking, ~piece_colors[CT], blockers);
@@ -314,8 +280,8 @@ int MoveGenerator::generateMoves(Position& pos, bool incl_quiets, std::vector<U3
     if (squareAttackedBy<CTO>(t, pos, blockers ^ (1ULL << myking)))
       pseudo_king_moves &= ~(1ULL << t);
   }
-  emplaceCaptures(myking, KING, piece_colors[CTO], pieces, pseudo_king_moves & piece_colors[CT ^ 1],
-                  move_tgts);
+  emplaceCaptures(myking, KING, piece_colors[CTO], pos.getPieces(),
+                  pseudo_king_moves & piece_colors[CT ^ 1], move_tgts);
   if (incl_quiets)
     emplaceNonCaptures(myking, KING, pseudo_king_moves & ~piece_colors[CT ^ 1], move_tgts);
 
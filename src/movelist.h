@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+#include "types.h"
+
+namespace Wyvern
+{
+
+// no legal chess position has more than 218 moves
+constexpr int max_moves = 256;
+
+/*
+
+fixed capacity move list that lives on the stack, so that move generation and
+search never allocate. each move carries an int score for move ordering; the
+score is left uninitialised by emplace_back and is the caller's to set.
+*/
+
+class MoveList
+{
+private:
+  std::array<U32, max_moves> moves;
+  std::array<int, max_moves> scores;
+  int count = 0;
+
+public:
+  void emplace_back(U32 move)
+  {
+    moves[count++] = move;
+  }
+  void clear()
+  {
+    count = 0;
+  }
+  size_t size() const
+  {
+    return count;
+  }
+  bool empty() const
+  {
+    return count == 0;
+  }
+  U32& operator[](size_t i)
+  {
+    return moves[i];
+  }
+  U32 operator[](size_t i) const
+  {
+    return moves[i];
+  }
+  int& score(size_t i)
+  {
+    return scores[i];
+  }
+  int score(size_t i) const
+  {
+    return scores[i];
+  }
+  U32 back() const
+  {
+    return moves[count - 1];
+  }
+  // swaps two moves along with their scores
+  void swap(size_t i, size_t j)
+  {
+    std::swap(moves[i], moves[j]);
+    std::swap(scores[i], scores[j]);
+  }
+  U32* begin()
+  {
+    return moves.data();
+  }
+  U32* end()
+  {
+    return moves.data() + count;
+  }
+  const U32* begin() const
+  {
+    return moves.data();
+  }
+  const U32* end() const
+  {
+    return moves.data() + count;
+  }
+};
+
+} // namespace Wyvern
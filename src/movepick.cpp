@@ -0,0 +1,83 @@
+#include "movepick.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace Wyvern
+{
+
+MoveHistory::MoveHistory()
+{
+  clear();
+}
+
+void MoveHistory::clear()
+{
+  for (auto& slots : killers)
+    slots.fill(MOVE_NONE);
+  for (auto& side : history)
+    for (auto& from : side)
+      from.fill(0);
+  for (auto& from : countermoves)
+    from.fill(MOVE_NONE);
+}
+
+void MoveHistory::newSearch()
+{
+  for (auto& slots : killers)
+    slots.fill(MOVE_NONE);
+  for (auto& side : history)
+    for (auto& from : side)
+      for (int& h : from)
+        h /= 2;
+  for (auto& from : countermoves)
+    from.fill(MOVE_NONE);
+}
+
+U32 MoveHistory::killer(int ply, int slot) const
+{
+  return (ply < max_killer_ply) ? killers[ply][slot] : MOVE_NONE;
+}
+
+U32 MoveHistory::countermove(U32 previous) const
+{
+  if (previous == MOVE_NONE || previous == MOVE_NULL)
+    return MOVE_NONE;
+  return countermoves[previous & 63][(previous >> 6) & 63];
+}
+
+int MoveHistory::score(enum Color side, U32 move) const
+{
+  return history[side][move & 63][(move >> 6) & 63];
+}
+
+// the bonus grows with the depth squared, and each update moves a score only
+// part of the way to the limit, so that the scores stay in range and old
+// cutoffs fade
+void MoveHistory::cutoff(enum Color side, int ply, int depth, U32 previous, const U32* moves,
+                         int index)
+{
+  U32 move = moves[index];
+  if (ply < max_killer_ply && killers[ply][0] != move)
+  {
+    killers[ply][1] = killers[ply][0];
+    killers[ply][0] = move;
+  }
+  if (previous != MOVE_NONE && previous != MOVE_NULL)
+    countermoves[previous & 63][(previous >> 6) & 63] = move;
+  int bonus = std::min(depth * depth, history_max / 32);
+  auto update = [&](U32 m, int b)
+  {
+    int& h = history[side][m & 63][(m >> 6) & 63];
+    h += b - h * std::abs(b) / history_max;
+  };
+  update(move, bonus);
+  // the quiet moves tried before it were no good here
+  for (int i = 0; i < index; i++)
+  {
+    if (isQuiet(moves[i]))
+      update(moves[i], -bonus);
+  }
+}
+
+} // namespace Wyvern
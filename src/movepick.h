@@ -0,0 +1,169 @@
+#pragma once
+
+#include "evaluate.h"
+#include "movelist.h"
+#include "position.h"
+#include "types.h"
+#include <algorithm>
+#include <array>
+
+namespace Wyvern
+{
+
+// plies with killer slots of their own; deeper nodes go without
+constexpr int max_killer_ply = 128;
+// history scores stay within plus or minus this
+constexpr int history_max = 1 << 14;
+
+// neither a capture nor a promotion
+inline bool isQuiet(U32 move)
+{
+  return !(move & YES_CAPTURE) && (move & MOVE_SPECIAL) != PROMO;
+}
+
+/*
+
+quiet move ordering learned from beta cutoffs, one per search thread: two
+killer moves for each ply, a butterfly history by side, from and to square,
+and the reply that last refuted each move, by that move's from and to square.
+*/
+
+class MoveHistory
+{
+private:
+  std::array<std::array<U32, 2>, max_killer_ply> killers;
+  std::array<std::array<std::array<int, 64>, 64>, 2> history;
+  std::array<std::array<U32, 64>, 64> countermoves;
+
+public:
+  MoveHistory();
+  void clear();
+  // between the searches of a game: killers and countermoves belong to the
+  // last position and go, the history is halved
+  void newSearch();
+  U32 killer(int ply, int slot) const;
+  U32 countermove(U32 previous) const;
+  int score(enum Color side, U32 move) const;
+  // the quiet moves[index] failed high at ply after moves[0..index) did not,
+  // in a search of depth plies replying to previous
+  void cutoff(enum Color side, int ply, int depth, U32 previous, const U32* moves, int index);
+};
+
+/*
+
+hands out the moves of a node in stages: the hash move, captures that do not
+lose material by see and queen promotions, the two killers, the countermove,
+the other quiet moves by history, and last the losing captures and the
+underpromotions. each move is swapped into place as it is asked for, so the
+list keeps the order it was searched in; nothing is scored until the hash move
+has failed to cut off.
+*/
+
+template <enum Color CT> class MovePicker
+{
+private:
+  static constexpr int good_noisy = 1 << 28;
+  static constexpr int killer_move = 1 << 27;
+  static constexpr int bad_noisy = -(1 << 28);
+  static constexpr int underpromotion = -(1 << 29);
+
+  MoveList& moves;
+  const Position& pos;
+  Evaluator& evaluator;
+  const MoveHistory& history;
+  int ply;
+  bool staged;
+  bool hash_found = false;
+  bool scored = false;
+  int picked = 0;
+
+  void score();
+
+public:
+  // with staged false, moves after the hash move keep their generation order
+  MovePicker(MoveList& _moves, const Position& _pos, Evaluator& _evaluator,
+             const MoveHistory& _history, int _ply, U32 hash_move, bool _staged);
+  bool hasHashMove() const
+  {
+    return hash_found;
+  }
+  // moves[i], picked first if it has not been; i goes up one at a time
+  U32 pick(int i);
+};
+
+template <enum Color CT>
+MovePicker<CT>::MovePicker(MoveList& _moves, const Position& _pos, Evaluator& _evaluator,
+                           const MoveHistory& _history, int _ply, U32 hash_move, bool _staged)
+    : moves(_moves), pos(_pos), evaluator(_evaluator), history(_history), ply(_ply),
+      staged(_staged)
+{
+  if (hash_move == MOVE_NONE)
+    return;
+  // the others keep their order, which is all the ordering they get unstaged
+  auto hm = std::find(moves.begin(), moves.end(), hash_move);
+  if (hm == moves.end())
+    return;
+  std::rotate(moves.begin(), hm, hm + 1);
+  hash_found = true;
+  picked = 1;
+}
+
+template <enum Color CT> U32 MovePicker<CT>::pick(int i)
+{
+  if (i < picked || !staged)
+    return moves[i];
+  if (!scored)
+  {
+    score();
+    scored = true;
+  }
+  int best = i;
+  for (int j = i + 1; j < static_cast<int>(moves.size()); j++)
+  {
+    if (moves.score(j) > moves.score(best))
+      best = j;
+  }
+  moves.swap(i, best);
+  picked = i + 1;
+  return moves[i];
+}
+
+template <enum Color CT> void MovePicker<CT>::score()
+{
+  U32 previous = (pos.getGamePly() > 0) ? pos.getHistoryMove(1) : MOVE_NONE;
+  U32 killer0 = history.killer(ply, 0);
+  U32 killer1 = history.killer(ply, 1);
+  U32 counter = history.countermove(previous);
+  for (size_t i = picked; i < moves.size(); i++)
+  {
+    U32 move = moves[i];
+    int& s = moves.score(i);
+    if (isQuiet(move))
+    {
+      if (move == killer0)
+        s = killer_move + 2;
+      else if (move == killer1)
+        s = killer_move + 1;
+      else if (move == counter)
+        s = killer_move;
+      else
+        s = history.score(CT, move);
+      continue;
+    }
+    if ((move & MOVE_SPECIAL) == PROMO && ((move >> 12) & 3) != 3)
+    {
+      s = underpromotion;
+      continue;
+    }
+    // most valuable victim, least valuable attacker
+    int victim = (move >> 17) & 7;
+    int attacker = (move >> 20) & 7;
+    int mvv_lva = 8 * victim - attacker + (((move & MOVE_SPECIAL) == PROMO) ? 8 * QUEEN : 0);
+    // taking a piece worth as much as the taker cannot lose material
+    bool good = !(move & YES_CAPTURE) || victim >= attacker ||
+                evaluator.seeCapture<CT>(pos, move) >= 0;
+    s = (good ? good_noisy : bad_noisy) + mvv_lva;
+  }
+}
+
+} // namespace Wyvern
@@ -0,0 +1,260 @@
+#include "nnue.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace Wyvern
+{
+
+namespace
+{
+
+enum class Kernel
+{
+  SCALAR,
+  SSE2,
+  AVX2
+};
+
+Kernel detectKernel()
+{
+  if (cpuHasAvx2())
+    return Kernel::AVX2;
+#if defined(WYVERN_SIMD_X86)
+  return Kernel::SSE2;
+#else
+  return Kernel::SCALAR;
+#endif
+}
+
+const Kernel kernel = detectKernel();
+
+// black's feature index for white's: colours swapped, board flipped
+constexpr int flipFeature(int feature)
+{
+  return ((feature + 384) % nnue_inputs) ^ 56;
+}
+
+void updateScalar(const int16_t* from, int16_t* to, const int16_t* const* add, int added,
+                  const int16_t* const* remove, int removed)
+{
+  for (int i = 0; i < nnue_hidden; i++)
+  {
+    int16_t v = from[i];
+    for (int a = 0; a < added; a++)
+      v += add[a][i];
+    for (int r = 0; r < removed; r++)
+      v -= remove[r][i];
+    to[i] = v;
+  }
+}
+
+int dotScalar(const int16_t* us, const int16_t* them, const int16_t* weights)
+{
+  int sum = 0;
+  for (int i = 0; i < nnue_hidden; i++)
+  {
+    sum += std::clamp<int>(us[i], 0, nnue_qa) * weights[i];
+    sum += std::clamp<int>(them[i], 0, nnue_qa) * weights[nnue_hidden + i];
+  }
+  return sum;
+}
+
+#if defined(WYVERN_SIMD_X86)
+void updateSse2(const int16_t* from, int16_t* to, const int16_t* const* add, int added,
+                const int16_t* const* remove, int removed)
+{
+  for (int i = 0; i < nnue_hidden; i += 8)
+  {
+    __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(from + i));
+    for (int a = 0; a < added; a++)
+      v = _mm_add_epi16(v, _mm_load_si128(reinterpret_cast<const __m128i*>(add[a] + i)));
+    for (int r = 0; r < removed; r++)
+      v = _mm_sub_epi16(v, _mm_load_si128(reinterpret_cast<const __m128i*>(remove[r] + i)));
+    _mm_store_si128(reinterpret_cast<__m128i*>(to + i), v);
+  }
+}
+
+int dotSse2(const int16_t* us, const int16_t* them, const int16_t* weights)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i qa = _mm_set1_epi16(nnue_qa);
+  __m128i sum = zero;
+  for (int i = 0; i < nnue_hidden; i += 8)
+  {
+    __m128i u = _mm_load_si128(reinterpret_cast<const __m128i*>(us + i));
+    __m128i t = _mm_load_si128(reinterpret_cast<const __m128i*>(them + i));
+    u = _mm_min_epi16(_mm_max_epi16(u, zero), qa);
+    t = _mm_min_epi16(_mm_max_epi16(t, zero), qa);
+    __m128i wu = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + i));
+    __m128i wt = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + nnue_hidden + i));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(u, wu));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(t, wt));
+  }
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+  return _mm_cvtsi128_si32(sum);
+}
+#endif
+
+#if defined(WYVERN_SIMD_AVX2)
+WYVERN_TARGET_AVX2 void updateAvx2(const int16_t* from, int16_t* to, const int16_t* const* add,
+                                   int added, const int16_t* const* remove, int removed)
+{
+  for (int i = 0; i < nnue_hidden; i += 16)
+  {
+    __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(from + i));
+    for (int a = 0; a < added; a++)
+      v = _mm256_add_epi16(v, _mm256_load_si256(reinterpret_cast<const __m256i*>(add[a] + i)));
+    for (int r = 0; r < removed; r++)
+      v = _mm256_sub_epi16(v, _mm256_load_si256(reinterpret_cast<const __m256i*>(remove[r] + i)));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(to + i), v);
+  }
+}
+
+WYVERN_TARGET_AVX2 int dotAvx2(const int16_t* us, const int16_t* them, const int16_t* weights)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i qa = _mm256_set1_epi16(nnue_qa);
+  __m256i sum = zero;
+  for (int i = 0; i < nnue_hidden; i += 16)
+  {
+    __m256i u = _mm256_load_si256(reinterpret_cast<const __m256i*>(us + i));
+    __m256i t = _mm256_load_si256(reinterpret_cast<const __m256i*>(them + i));
+    u = _mm256_min_epi16(_mm256_max_epi16(u, zero), qa);
+    t = _mm256_min_epi16(_mm256_max_epi16(t, zero), qa);
+    __m256i wu = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i));
+    __m256i wt = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + nnue_hidden + i));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(u, wu));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(t, wt));
+  }
+  __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+  return _mm_cvtsi128_si32(half);
+}
+#endif
+
+void updateKernel(const int16_t* from, int16_t* to, const int16_t* const* add, int added,
+                  const int16_t* const* remove, int removed)
+{
+  switch (kernel)
+  {
+#if defined(WYVERN_SIMD_AVX2)
+    case Kernel::AVX2:
+      return updateAvx2(from, to, add, added, remove, removed);
+#endif
+#if defined(WYVERN_SIMD_X86)
+    case Kernel::SSE2:
+      return updateSse2(from, to, add, added, remove, removed);
+#endif
+    default:
+      return updateScalar(from, to, add, added, remove, removed);
+  }
+}
+
+int dotKernel(const int16_t* us, const int16_t* them, const int16_t* weights)
+{
+  switch (kernel)
+  {
+#if defined(WYVERN_SIMD_AVX2)
+    case Kernel::AVX2:
+      return dotAvx2(us, them, weights);
+#endif
+#if defined(WYVERN_SIMD_X86)
+    case Kernel::SSE2:
+      return dotSse2(us, them, weights);
+#endif
+    default:
+      return dotScalar(us, them, weights);
+  }
+}
+
+} // namespace
+
+const char* const nnue_kernel = (kernel == Kernel::AVX2)   ? "avx2"
+                                : (kernel == Kernel::SSE2) ? "sse2"
+                                                           : "scalar";
+
+bool NnueNetwork::load(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+  std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  return load(data.data(), data.size());
+}
+
+// assumes a little endian host, as are all the targets we build for
+bool NnueNetwork::load(const char* data, size_t size)
+{
+  if (size < file_size)
+    return false;
+  auto read = [&data](auto& array)
+  {
+    std::memcpy(array.data(), data, sizeof(array));
+    data += sizeof(array);
+  };
+  read(feature_weights);
+  read(feature_bias);
+  read(output_weights);
+  std::memcpy(&output_bias, data, sizeof(output_bias));
+  return true;
+}
+
+void NnueNetwork::refresh(NnueAccumulator& acc, const U64* pieces, const U64* colors) const
+{
+  acc.values[0] = feature_bias;
+  acc.values[1] = feature_bias;
+  for (int pt = 0; pt < 6; pt++)
+  {
+    for (int color = 0; color < 2; color++)
+    {
+      for (U64 ps = pieces[pt] & colors[color]; ps; ps &= ps - 1)
+      {
+        int feature = nnueFeature(color, pt, std::countr_zero(ps));
+        const int16_t* white = feature_weights.data() + feature * nnue_hidden;
+        const int16_t* black = feature_weights.data() + flipFeature(feature) * nnue_hidden;
+        updateKernel(acc.values[0].data(), acc.values[0].data(), &white, 1, nullptr, 0);
+        updateKernel(acc.values[1].data(), acc.values[1].data(), &black, 1, nullptr, 0);
+      }
+    }
+  }
+}
+
+void NnueNetwork::update(const NnueAccumulator& from, NnueAccumulator& to,
+                         const NnueDelta& delta) const
+{
+  for (int side = 0; side < 2; side++)
+  {
+    const int16_t* add[2];
+    const int16_t* remove[2];
+    for (int a = 0; a < delta.added; a++)
+    {
+      int feature = side ? flipFeature(delta.add[a]) : delta.add[a];
+      add[a] = feature_weights.data() + feature * nnue_hidden;
+    }
+    for (int r = 0; r < delta.removed; r++)
+    {
+      int feature = side ? flipFeature(delta.remove[r]) : delta.remove[r];
+      remove[r] = feature_weights.data() + feature * nnue_hidden;
+    }
+    updateKernel(from.values[side].data(), to.values[side].data(), add, delta.added, remove,
+                 delta.removed);
+  }
+}
+
+int NnueNetwork::evaluate(const NnueAccumulator& acc, int color) const
+{
+  int sum = dotKernel(acc.values[color].data(), acc.values[color ^ 1].data(),
+                      output_weights.data());
+  return static_cast<int>((static_cast<int64_t>(sum) + output_bias) * nnue_scale /
+                          (nnue_qa * nnue_qb));
+}
+
+} // namespace Wyvern
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "types.h"
+
+namespace Wyvern
+{
+
+// a 768 -> 2x256 -> 1 network. each side has an accumulator over the 768
+// (colour, piece, square) inputs seen from its own side of the board: its own
+// pieces first, squares flipped for black. the evaluation is the clipped
+// accumulators, side to move first, dotted with the output weights.
+//
+// weight files are little endian int16 in the order feature weights
+// [768][256], feature biases [256], output weights [512], output bias, as
+// written by bullet's simple quantised format. trailing padding is ignored.
+constexpr int nnue_inputs = 768;
+constexpr int nnue_hidden = 256;
+constexpr int nnue_qa = 255;
+constexpr int nnue_qb = 64;
+constexpr int nnue_scale = 400;
+
+struct alignas(64) NnueAccumulator
+{
+  std::array<std::array<int16_t, nnue_hidden>, 2> values;
+};
+
+// inputs switched on and off by one move, as white's feature indices
+struct NnueDelta
+{
+  int added = 0;
+  int removed = 0;
+  std::array<U16, 2> add;
+  std::array<U16, 2> remove;
+};
+
+// white's feature index for a piece; PieceType - 1 as in Position::pieces
+constexpr int nnueFeature(int color, int pt, int sq)
+{
+  return color * 384 + pt * 64 + sq;
+}
+
+// the kernels in use: "avx2", "sse2" or "scalar", picked from the cpu at startup
+extern const char* const nnue_kernel;
+
+class NnueNetwork
+{
+private:
+  alignas(64) std::array<int16_t, nnue_inputs * nnue_hidden> feature_weights;
+  alignas(64) std::array<int16_t, nnue_hidden> feature_bias;
+  alignas(64) std::array<int16_t, 2 * nnue_hidden> output_weights;
+  int16_t output_bias;
+
+public:
+  static constexpr size_t file_size =
+    sizeof(int16_t) * (nnue_inputs * nnue_hidden + nnue_hidden + 2 * nnue_hidden + 1);
+
+  // false if the file is missing or too short; the network is then unchanged
+  bool load(const std::string& path);
+  bool load(const char* data, size_t size);
+
+  // accumulators from scratch, from the piece and colour bitboards
+  void refresh(NnueAccumulator& acc, const U64* pieces, const U64* colors) const;
+  // to is from with the delta's inputs switched on and off
+  void update(const NnueAccumulator& from, NnueAccumulator& to, const NnueDelta& delta) const;
+  // centipawns for color to move
+  int evaluate(const NnueAccumulator& acc, int color) const;
+};
+
+} // namespace Wyvern
@@ -0,0 +1,201 @@
+#include "perft.h"
+
+#include "search.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace Wyvern
+{
+
+PerftCounters& PerftCounters::operator+=(const PerftCounters& other)
+{
+  nodes += other.nodes;
+  captures += other.captures;
+  en_passant += other.en_passant;
+  castles += other.castles;
+  promotions += other.promotions;
+  checks += other.checks;
+  return *this;
+}
+
+static U64 loadWord(U64& word)
+{
+  return std::atomic_ref<U64>(word).load(std::memory_order_relaxed);
+}
+
+static void storeWord(U64& word, U64 value)
+{
+  std::atomic_ref<U64>(word).store(value, std::memory_order_relaxed);
+}
+
+PerftTable::PerftTable(size_t mb)
+    : table(std::bit_floor(std::max<size_t>(mb * 1024 * 1024 / sizeof(Entry), 1)))
+{
+}
+
+// the same position at different depths goes to different entries
+size_t PerftTable::index(U64 key, int depth) const
+{
+  return (key ^ (depth * 0x9E3779B97F4A7C15ULL)) & (table.size() - 1);
+}
+
+bool PerftTable::lookup(U64 key, int depth, PerftCounters& out)
+{
+  Entry& e = table[index(key, depth)];
+  U64 words[6];
+  U64 check = loadWord(e.check) ^ loadWord(e.depth);
+  for (int i = 0; i < 6; i++)
+  {
+    words[i] = loadWord(e.counters[i]);
+    check ^= words[i];
+  }
+  if (check != key || loadWord(e.depth) != static_cast<U64>(depth))
+    return false;
+  out = PerftCounters{words[0], words[1], words[2], words[3], words[4], words[5]};
+  return true;
+}
+
+void PerftTable::insert(U64 key, int depth, const PerftCounters& counters)
+{
+  Entry& e = table[index(key, depth)];
+  const U64 words[6] = {counters.nodes,   counters.captures,   counters.en_passant,
+                        counters.castles, counters.promotions, counters.checks};
+  U64 check = key ^ static_cast<U64>(depth);
+  storeWord(e.depth, depth);
+  for (int i = 0; i < 6; i++)
+  {
+    storeWord(e.counters[i], words[i]);
+    check ^= words[i];
+  }
+  storeWord(e.check, check);
+}
+
+static void perftNode(MoveGenerator& movegen, Position& pos, int depth, PerftTable* table,
+                      bool validate, PerftCounters& out);
+
+// counts the subtree under one move; the move itself is classified here when
+// it leads to a leaf
+static void perftMove(MoveGenerator& movegen, Position& pos, U32 move, int depth,
+                      PerftTable* table, bool validate, PerftCounters& out)
+{
+  if (depth == 1)
+  {
+    if (move & YES_CAPTURE)
+      out.captures++;
+    if ((move & MOVE_SPECIAL) == ENPASSANT)
+    {
+      out.en_passant++;
+      out.captures++;
+    }
+    if ((move & MOVE_SPECIAL) == PROMO)
+      out.promotions++;
+    if ((move & MOVE_SPECIAL) == CASTLES)
+      out.castles++;
+  }
+  pos.makeMove(move);
+  perftNode(movegen, pos, depth - 1, table, validate, out);
+  pos.unmakeMove();
+}
+
+static void perftNode(MoveGenerator& movegen, Position& pos, int depth, PerftTable* table,
+                      bool validate, PerftCounters& out)
+{
+  if (validate && pos.checkValidity())
+  {
+    pos.printPretty();
+    for (int ply = pos.getGamePly(); ply > 0; ply--)
+    {
+      U32 move = pos.getHistoryMove(ply);
+      std::cout << std::hex << (move >> 12) << std::dec << "|" << moveString(move) << " -> ";
+    }
+    std::cout << "\n";
+    std::cin.get();
+  }
+  if (depth == 0)
+  {
+    out.nodes++;
+    if (movegen.inCheck(pos))
+      out.checks++;
+    return;
+  }
+  // depth 1 subtrees are cheaper to count than to look up
+  bool use_table = table && depth >= 2;
+  PerftCounters sub;
+  if (use_table && table->lookup(pos.getZobrist(), depth, sub))
+  {
+    out += sub;
+    return;
+  }
+  MoveList moves;
+  if (pos.getToMove() == COLOR_WHITE)
+    movegen.generateMoves<COLOR_WHITE>(pos, true, moves);
+  else
+    movegen.generateMoves<COLOR_BLACK>(pos, true, moves);
+  for (U32 move : moves)
+    perftMove(movegen, pos, move, depth, table, validate, sub);
+  if (use_table)
+    table->insert(pos.getZobrist(), depth, sub);
+  out += sub;
+}
+
+PerftCounters Search::perft(Position& pos, int depth, const PerftOptions& options)
+{
+  auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<PerftTable> table;
+  if (options.hash_mb)
+    table = std::make_unique<PerftTable>(options.hash_mb);
+
+  PerftCounters total;
+  if (depth <= 0)
+  {
+    perftNode(movegen, pos, 0, nullptr, options.validate, total);
+    return total;
+  }
+
+  MoveList moves;
+  if (pos.getToMove() == COLOR_WHITE)
+    movegen.generateMoves<COLOR_WHITE>(pos, true, moves);
+  else
+    movegen.generateMoves<COLOR_BLACK>(pos, true, moves);
+
+  // each thread takes the next unclaimed root move on its own copy of the
+  // position; the move generator and the table are shared
+  std::vector<PerftCounters> results(moves.size());
+  std::atomic<size_t> next_move = 0;
+  auto work = [&](Position& root)
+  {
+    for (size_t i = next_move++; i < moves.size(); i = next_move++)
+      perftMove(movegen, root, moves[i], depth, table.get(), options.validate, results[i]);
+  };
+  int threads = std::clamp(options.threads, 1, std::max<int>(moves.size(), 1));
+  std::vector<Position> copies(threads - 1, pos);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads - 1; t++)
+    workers.emplace_back(work, std::ref(copies[t]));
+  work(pos);
+  for (auto& w : workers)
+    w.join();
+
+  for (size_t i = 0; i < moves.size(); i++)
+  {
+    total += results[i];
+    if (options.divide)
+      std::cout << moveString(moves[i]) << ": " << results[i].nodes << "\n";
+  }
+  if (options.divide)
+  {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "\nNodes searched: " << total.nodes << " in " << elapsed.count() << "s ("
+              << static_cast<U64>(total.nodes / std::max(elapsed.count(), 1e-9)) << " nps, "
+              << threads << " threads)" << std::endl;
+  }
+  return total;
+}
+
+} // namespace Wyvern
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "types.h"
+
+namespace Wyvern
+{
+
+struct PerftCounters
+{
+  U64 nodes = 0;
+  U64 captures = 0;
+  U64 en_passant = 0;
+  U64 castles = 0;
+  U64 promotions = 0;
+  U64 checks = 0;
+  PerftCounters& operator+=(const PerftCounters& other);
+};
+
+struct PerftOptions
+{
+  // root moves are shared out between this many threads
+  int threads = 1;
+  // size of the perft hash table in megabytes, 0 for none
+  size_t hash_mb = 0;
+  // print the node count under each root move, then the total and nodes/sec
+  bool divide = false;
+  // run Position::checkValidity at every node; slow, for debugging movegen
+  bool validate = false;
+};
+
+// perft results keyed by zobrist key and remaining depth. each entry is one
+// cache line holding the depth and the six counters, plus a check word equal
+// to the key xor'd with all of them. entries are read and written with relaxed
+// atomics and no locks: an entry torn by two threads writing at once fails the
+// check and reads as a miss. entries are always replaced.
+class PerftTable
+{
+private:
+  struct alignas(64) Entry
+  {
+    U64 check = 0;
+    U64 depth = 0;
+    U64 counters[6] = {};
+  };
+
+  std::vector<Entry> table;
+  size_t index(U64 key, int depth) const;
+
+public:
+  explicit PerftTable(size_t mb);
+  bool lookup(U64 key, int depth, PerftCounters& out);
+  void insert(U64 key, int depth, const PerftCounters& counters);
+};
+
+} // namespace Wyvern
@@ -1,5 +1,9 @@
 #include "position.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <sstream>
+#include <string>
 
 namespace Wyvern
 {
@@ -19,9 +23,15 @@ void Position::zobristHash()
     }
     for (; black_ps; black_ps &= black_ps - 1)
     {
-      value ^= zobristNum(i, 0, std::countr_zero(black_ps));
+      value ^= zobristNum(i, 1, std::countr_zero(black_ps));
     }
   }
+  pawn_key = 0;
+  for (U64 pawns = pieces[PAWN - 1]; pawns; pawns &= pawns - 1)
+  {
+    int p = std::countr_zero(pawns);
+    pawn_key ^= zobristNum(PAWN - 1, (piece_colors[1] >> p) & 1, p);
+  }
   value ^= zobristEP(ep_square);
   value ^= zobristCR(castling);
   if (tomove == COLOR_BLACK)
@@ -29,6 +39,41 @@ void Position::zobristHash()
   zobrist = value;
 }
 
+void Position::pieceAdded(int color, int pt, int sq)
+{
+  const PsqtEntry& e = psqt_entries[color][pt][sq];
+  scores.middle_game[color] += e.middle_game;
+  scores.end_game[color] += e.end_game;
+  scores.material[color] += e.material;
+  scores.phase += e.phase;
+  if (network)
+    nnue_delta.add[nnue_delta.added++] = nnueFeature(color, pt, sq);
+}
+
+void Position::pieceRemoved(int color, int pt, int sq)
+{
+  const PsqtEntry& e = psqt_entries[color][pt][sq];
+  scores.middle_game[color] -= e.middle_game;
+  scores.end_game[color] -= e.end_game;
+  scores.material[color] -= e.material;
+  scores.phase -= e.phase;
+  if (network)
+    nnue_delta.remove[nnue_delta.removed++] = nnueFeature(color, pt, sq);
+}
+
+void Position::refreshScores()
+{
+  scores = PsqtScores{};
+  for (int i = 0; i < 6; i++)
+  {
+    for (int color = 0; color < 2; color++)
+    {
+      for (U64 ps = pieces[i] & piece_colors[color]; ps; ps &= ps - 1)
+        pieceAdded(color, i, std::countr_zero(ps));
+    }
+  }
+}
+
 int Position::makeMove(U32 move)
 {
   int isq = move & 0x3F;
@@ -40,11 +85,36 @@ int Position::makeMove(U32 move)
   U64 ibb = 1ULL << isq;
   U64 tbb = 1ULL << tsq;
   int pt = ((move >> 20) & 7) - 1;
-  cr_history.emplace_back(castling);
-  hmc_history.emplace_back(fifty_half_moves);
-  position_history.emplace_back(zobrist);
+  if (game_ply == (int)states.size())
+    states.resize(std::max<size_t>(states.size() * 2, initial_state_capacity));
+  StateInfo& st = states[game_ply++];
+  st.zobrist = zobrist;
+  st.pawn_key = pawn_key;
+  st.scores = scores;
+  st.move = move;
+  st.hmc = static_cast<U16>(fifty_half_moves);
+  st.castling = static_cast<U8>(castling);
+  st.captured = static_cast<U8>(is_capture ? capture_piece + 1 : PIECE_NONE);
+  st.ep_square = static_cast<U8>(ep_square ? std::countr_zero(ep_square) : 64);
+  nnue_delta.added = 0;
+  nnue_delta.removed = 0;
+  if (move == MOVE_NULL)
+  {
+    // a pass: only the side to move and the en passant square change. the
+    // fifty move count carries on; the repetition check stops at the pass
+    zobrist ^= zobristEP(ep_square) ^ zobristToMove();
+    ep_square = 0;
+    fifty_half_moves++;
+    full_moves += tomove;
+    tomove = (enum Color)(tomove ^ 1);
+    updateAccumulator();
+    return 0;
+  }
   // zobrist out old piece position
   zobrist ^= zobristNum(pt, tomove, isq);
+  pieceRemoved(tomove, pt, isq);
+  if (pt == PAWN - 1)
+    pawn_key ^= zobristNum(PAWN - 1, tomove, isq);
   // hash-out old zobrist ep before setting to ep_square = 0
   zobrist ^= zobristEP(ep_square);
   ep_square = 0;
@@ -57,14 +127,24 @@ int Position::makeMove(U32 move)
     // zobrist in our target, and out enemy pawn
     zobrist ^= zobristNum(PAWN - 1, tomove ^ 1, std::countr_zero(ep_tgt));
     zobrist ^= zobristNum(PAWN - 1, tomove, tsq);
+    pieceRemoved(tomove ^ 1, PAWN - 1, std::countr_zero(ep_tgt));
+    pieceAdded(tomove, PAWN - 1, tsq);
+    pawn_key ^= zobristNum(PAWN - 1, tomove ^ 1, std::countr_zero(ep_tgt));
+    pawn_key ^= zobristNum(PAWN - 1, tomove, tsq);
     pieces[PAWN - 1] ^= ibb ^ tbb ^ ep_tgt;
     piece_colors[tomove] ^= ibb ^ tbb;
     piece_colors[tomove ^ 1] ^= ep_tgt;
+    board[std::countr_zero(ep_tgt)] = PIECE_NONE;
   }
+  board[isq] = PIECE_NONE;
+  board[tsq] = pt + 1;
   if (special == NORMAL)
   {
     piece_colors[tomove] ^= ibb ^ tbb;
     zobrist ^= zobristNum(pt, tomove, tsq); // zobrist in our target
+    pieceAdded(tomove, pt, tsq);
+    if (pt == PAWN - 1)
+      pawn_key ^= zobristNum(PAWN - 1, tomove, tsq);
     pieces[pt] ^= ibb ^ tbb;
     if (pt == (PAWN - 1) && ((ibb >> 16) == tbb || (tbb >> 16) == ibb))
       ep_square = 1ULL << ((isq + tsq) / 2);
@@ -91,6 +171,8 @@ int Position::makeMove(U32 move)
     pieces[promo_piece] ^= tbb;
     pieces[PAWN - 1] ^= ibb;
     zobrist ^= zobristNum(promo_piece, tomove, tsq);
+    pieceAdded(tomove, promo_piece, tsq);
+    board[tsq] = promo_piece + 1;
   }
   if (special == CASTLES)
   {
@@ -100,6 +182,11 @@ int Position::makeMove(U32 move)
     U64 rook_tsq = (ibb > tbb) ? castle_rank & FILE_D : castle_rank & FILE_F;
     // zobrist rook move
     zobrist ^= zobristNum(ROOK - 1, tomove, rook_isq) ^ zobristNum(ROOK - 1, tomove, rook_tsq);
+    pieceAdded(tomove, KING - 1, tsq);
+    pieceRemoved(tomove, ROOK - 1, std::countr_zero(rook_isq));
+    pieceAdded(tomove, ROOK - 1, std::countr_zero(rook_tsq));
+    board[std::countr_zero(rook_isq)] = PIECE_NONE;
+    board[std::countr_zero(rook_tsq)] = ROOK;
     pieces[ROOK - 1] ^= rook_isq ^ rook_tsq;
     pieces[KING - 1] ^= ibb ^ tbb;
     piece_colors[tomove] ^= rook_isq ^ rook_tsq ^ ibb ^ tbb;
@@ -111,6 +198,9 @@ int Position::makeMove(U32 move)
     fifty_half_moves = 0;
     // zobrist out enemy piece
     zobrist ^= zobristNum(capture_piece, tomove ^ 1, tsq);
+    pieceRemoved(tomove ^ 1, capture_piece, tsq);
+    if (capture_piece == PAWN - 1)
+      pawn_key ^= zobristNum(PAWN - 1, tomove ^ 1, tsq);
     piece_colors[tomove ^ 1] ^= tbb;
     pieces[capture_piece] ^= tbb;
     if (tbb & FILE_A & RANK_1)
@@ -124,80 +214,90 @@ int Position::makeMove(U32 move)
   }
   // update zobrist cr and new ep square
   zobrist ^= zobristEP(ep_square);
-  zobrist ^= zobristCR((enum CastlingRights)(castling ^ cr_history.back()));
+  zobrist ^= zobristCR((enum CastlingRights)(castling ^ st.castling));
   // new zobrist
   zobrist ^= zobristToMove();
   full_moves += tomove;
   tomove = (enum Color)(tomove ^ 1);
-  move_history.emplace_back(move);
+  updateAccumulator();
   return 0;
 }
 
+void Position::updateAccumulator()
+{
+  if (!network)
+    return;
+  if (game_ply >= (int)accumulators.size())
+    accumulators.resize(2 * game_ply);
+  network->update(accumulators[game_ply - 1], accumulators[game_ply], nnue_delta);
+}
+
 int Position::unmakeMove()
 {
-  U32 move = move_history.back();
-  enum PieceType captured_piece = (enum PieceType)((move >> 17) & 7);
-  zobrist = position_history.back();
+  const StateInfo& st = states[--game_ply];
+  U32 move = st.move;
+  enum PieceType captured_piece = (enum PieceType)st.captured;
+  zobrist = st.zobrist;
+  pawn_key = st.pawn_key;
+  scores = st.scores;
   tomove = (enum Color)(tomove ^ 1);
   full_moves -= tomove;
-  int isq = move & 0x3F;
-  int tsq = (move >> 6) & 0x3F;
-  U64 ibb = 1ULL << isq;
-  U64 tbb = 1ULL << tsq;
-  int promo_piece = ((move >> 12) & 3) + 1;
-  int special = move & 0xC000;
-  int pt = ((move >> 20) & 7) - 1;
-  ep_square = 0;
-  if (YES_CAPTURE & move)
-  {
-    piece_colors[tomove ^ 1] ^= tbb;
-    pieces[captured_piece - 1] ^= tbb;
-  }
-  if (special == NORMAL)
-  {
-    piece_colors[tomove] ^= ibb ^ tbb;
-    pieces[pt] ^= ibb ^ tbb;
-  }
-  if (special == PROMO)
+  ep_square = (st.ep_square < 64) ? 1ULL << st.ep_square : 0;
+  fifty_half_moves = st.hmc;
+  castling = (enum CastlingRights)st.castling;
+  // a null move moved no pieces
+  if (move != MOVE_NULL)
   {
-    piece_colors[tomove] ^= ibb ^ tbb;
-    pieces[promo_piece] ^= tbb;
-    pieces[PAWN - 1] ^= ibb;
-  }
-  if (special == CASTLES)
-  {
-    U64 castle_rank = (tomove == COLOR_WHITE) ? RANK_1 : RANK_8;
-    U64 rook_isq = (ibb > tbb) ? castle_rank & FILE_A : castle_rank & FILE_H;
-    U64 rook_tsq = (ibb > tbb) ? castle_rank & FILE_D : castle_rank & FILE_F;
-    pieces[ROOK - 1] ^= rook_isq ^ rook_tsq;
-    pieces[KING - 1] ^= ibb ^ tbb;
-    piece_colors[tomove] ^= rook_isq ^ rook_tsq ^ ibb ^ tbb;
-  }
-  if (special == ENPASSANT)
-  {
-    ep_square = tbb;
-    U64 ep_tgt = (tomove) ? tbb << 8 : tbb >> 8;
-    pieces[PAWN - 1] ^= ibb ^ tbb ^ ep_tgt;
-    piece_colors[tomove] ^= ibb ^ tbb;
-    piece_colors[tomove ^ 1] ^= ep_tgt;
-  }
-  else if (move_history.size() > 0)
-  {
-    // RECOVER PREVIOUS EN PASSANT SQUARE
-    U32 prev_move = move_history.back();
-    int pm_t = 63 & (prev_move >> 6);
-    int pm_i = prev_move & 63;
-    if ((prev_move & MOVE_ALL_PIECES) == MOVE_PAWN)
+    int isq = move & 0x3F;
+    int tsq = (move >> 6) & 0x3F;
+    U64 ibb = 1ULL << isq;
+    U64 tbb = 1ULL << tsq;
+    int promo_piece = ((move >> 12) & 3) + 1;
+    int special = move & 0xC000;
+    int pt = ((move >> 20) & 7) - 1;
+    board[isq] = (special == PROMO) ? PAWN : pt + 1;
+    board[tsq] = captured_piece;
+    if (YES_CAPTURE & move)
+    {
+      piece_colors[tomove ^ 1] ^= tbb;
+      pieces[captured_piece - 1] ^= tbb;
+    }
+    if (special == NORMAL)
     {
-      ep_square = (1ULL << ((pm_t + pm_i) / 2)) & files[pm_i & 7];
+      piece_colors[tomove] ^= ibb ^ tbb;
+      pieces[pt] ^= ibb ^ tbb;
+    }
+    if (special == PROMO)
+    {
+      piece_colors[tomove] ^= ibb ^ tbb;
+      pieces[promo_piece] ^= tbb;
+      pieces[PAWN - 1] ^= ibb;
+    }
+    if (special == CASTLES)
+    {
+      U64 castle_rank = (tomove == COLOR_WHITE) ? RANK_1 : RANK_8;
+      U64 rook_isq = (ibb > tbb) ? castle_rank & FILE_A : castle_rank & FILE_H;
+      U64 rook_tsq = (ibb > tbb) ? castle_rank & FILE_D : castle_rank & FILE_F;
+      pieces[ROOK - 1] ^= rook_isq ^ rook_tsq;
+      pieces[KING - 1] ^= ibb ^ tbb;
+      piece_colors[tomove] ^= rook_isq ^ rook_tsq ^ ibb ^ tbb;
+      board[std::countr_zero(rook_isq)] = ROOK;
+      board[std::countr_zero(rook_tsq)] = PIECE_NONE;
+    }
+    if (special == ENPASSANT)
+    {
+      U64 ep_tgt = (tomove) ? tbb << 8 : tbb >> 8;
+      board[std::countr_zero(ep_tgt)] = PAWN;
+      pieces[PAWN - 1] ^= ibb ^ tbb ^ ep_tgt;
+      piece_colors[tomove] ^= ibb ^ tbb;
+      piece_colors[tomove ^ 1] ^= ep_tgt;
     }
   }
-  fifty_half_moves = hmc_history.back();
-  hmc_history.pop_back();
-  castling = cr_history.back();
-  cr_history.pop_back();
-  move_history.pop_back();
-  position_history.pop_back();
+  if (network && game_ply < nnue_base_ply)
+  {
+    nnue_base_ply = game_ply;
+    network->refresh(accumulators[game_ply], pieces.data(), piece_colors.data());
+  }
   return 0;
 }
 
@@ -206,14 +306,19 @@ enum Color Position::getToMove() const
   return tomove;
 }
 
-std::vector<U64>::const_reverse_iterator Position::positionHistoryIteratorBegin() const
+int Position::getGamePly() const
+{
+  return game_ply;
+}
+
+U32 Position::getHistoryMove(int plies_ago) const
 {
-  return position_history.crbegin();
+  return states[game_ply - plies_ago].move;
 }
 
-std::vector<U64>::const_reverse_iterator Position::positionHistoryIteratorEnd() const
+U64 Position::getHistoryZobrist(int plies_ago) const
 {
-  return position_history.crend();
+  return states[game_ply - plies_ago].zobrist;
 }
 
 U64 Position::getZobrist() const
@@ -221,6 +326,11 @@ U64 Position::getZobrist() const
   return zobrist;
 }
 
+U64 Position::getPawnKey() const
+{
+  return pawn_key;
+}
+
 Position::Position()
     : piece_colors{0xFFFFULL, 0xFFFF000000000000ULL}, ep_square(0),
       pieces{0x00FF00000000FF00ULL, 0x4200000000000042ULL, 0x2400000000000024ULL,
@@ -232,6 +342,8 @@ Position::Position()
              pieces[4] ^ pieces[5];
   if (invalid)
     std::cout << "DEFAULT POSITION CONSTRUCTOR BROKEN" << std::endl;
+  refreshBoard();
+  refreshScores();
   zobristHash();
 }
 
@@ -243,7 +355,9 @@ void Position::printPretty()
   const char dest_wsl = '(';
   const char dest_wsr = ')';
   const char dep_char = '+';
-  U32 last_move = (move_history.empty()) ? MOVE_NONE : move_history.back();
+  U32 last_move = (game_ply == 0) ? MOVE_NONE : getHistoryMove(1);
+  if (last_move == MOVE_NULL)
+    last_move = MOVE_NONE;
   int isq = (last_move) ? last_move & 63 : 64;
   int tsq = (last_move) ? (last_move >> 6) & 63 : 64;
   std::cout << "+---+---+---+---+---+---+---+---+ " << std::endl;
@@ -310,14 +424,55 @@ const U64* Position::getPieces() const
 {
   return pieces.data();
 }
-enum PieceType Position::pieceAtSquare(U64 sq)
+enum PieceType Position::pieceAtSquare(U64 sq) const
+{
+  if (!sq)
+    return PIECE_NONE;
+  return (enum PieceType)board[std::countr_zero(sq)];
+}
+
+const U8* Position::getBoard() const
+{
+  return board.data();
+}
+
+const PsqtScores& Position::getScores() const
+{
+  return scores;
+}
+
+void Position::setNetwork(const NnueNetwork* net)
+{
+  network = net;
+  if (!network)
+  {
+    accumulators.clear();
+    return;
+  }
+  if (game_ply >= (int)accumulators.size())
+    accumulators.resize(game_ply + 1);
+  nnue_base_ply = game_ply;
+  network->refresh(accumulators[game_ply], pieces.data(), piece_colors.data());
+}
+
+const NnueNetwork* Position::getNetwork() const
+{
+  return network;
+}
+
+const NnueAccumulator& Position::getAccumulator() const
+{
+  return accumulators[game_ply];
+}
+
+void Position::refreshBoard()
 {
+  board.fill(PIECE_NONE);
   for (int i = 0; i < 6; i++)
   {
-    if (sq & pieces[i])
-      return (enum PieceType)(i + 1);
+    for (U64 ps = pieces[i]; ps; ps &= ps - 1)
+      board[std::countr_zero(ps)] = i + 1;
   }
-  return PIECE_NONE;
 }
 
 U64 Position::getEpSquare()
@@ -344,9 +499,9 @@ int Position::checkValidity()
       printbb(pieces[i]);
       std::cout << "overlap:\n";
       printbb(all_pieces);
-      for (U32 m : move_history)
+      for (int ply = 0; ply < game_ply; ply++)
       {
-        std::cout << std::hex << m << std::dec << std::endl;
+        std::cout << std::hex << states[ply].move << std::dec << std::endl;
       }
       return 1;
     }
@@ -407,6 +562,27 @@ static int fenParseBoardChar(char c)
   return 0;
 }
 
+// the undo stack and accumulators are copied only up to the current ply, so
+// that copies kept as plain positions are small; makeMove preallocates again
+Position::Position(const Position& pos)
+    : piece_colors(pos.piece_colors), ep_square(pos.ep_square), pieces(pos.pieces),
+      board(pos.board), castling(pos.castling), tomove(pos.tomove),
+      fifty_half_moves(pos.fifty_half_moves), full_moves(pos.full_moves), zobrist(pos.zobrist),
+      pawn_key(pos.pawn_key), scores(pos.scores),
+      states(pos.states.begin(), pos.states.begin() + pos.game_ply), game_ply(pos.game_ply),
+      network(pos.network), nnue_base_ply(pos.nnue_base_ply), nnue_delta(pos.nnue_delta)
+{
+  if (network)
+    accumulators.assign(pos.accumulators.begin(), pos.accumulators.begin() + game_ply + 1);
+}
+
+Position& Position::operator=(const Position& pos)
+{
+  if (this != &pos)
+    *this = Position(pos);
+  return *this;
+}
+
 Position::Position(const char* fen)
 {
   int rank = 7;
@@ -417,16 +593,20 @@ Position::Position(const char* fen)
   fifty_half_moves = 0;
   full_moves = 0;
   ep_square = 0;
+  zobrist = 0;
   for (int i = 0; i < 6; i++)
   {
     pieces[i] = 0;
   }
   piece_colors[0] = 0;
   piece_colors[1] = 0;
+  board.fill(PIECE_NONE);
   while ((*fen) != '\0')
   {
     if (file > 8)
       return;
+    if (*fen == ' ')
+      break;
     int fc = fenParseBoardChar(*fen);
     if (!fc)
       return;
@@ -449,11 +629,40 @@ Position::Position(const char* fen)
       int piece = (fc / 64) - 1;
       pieces[piece] |= 1ULL << (file + 8 * rank);
       piece_colors[color] |= 1ULL << (file + 8 * rank);
+      board[file + 8 * rank] = piece + 1;
       file++;
     }
     fen++;
   }
+  parseFenFields(fen);
+  refreshScores();
   zobristHash();
 }
 
+// side to move, castling rights, en passant square and move counters, each
+// optional; the defaults are those of a placement-only fen
+void Position::parseFenFields(const char* fen)
+{
+  std::istringstream fields(fen);
+  std::string side, rights, ep, hmc, fmc;
+  fields >> side >> rights >> ep >> hmc >> fmc;
+  if (side == "b")
+    tomove = COLOR_BLACK;
+  if (!rights.empty())
+  {
+    int cr = CR_NONE;
+    for (char c : rights)
+    {
+      cr |= (c == 'K') ? CR_WK : (c == 'Q') ? CR_WQ : (c == 'k') ? CR_BK : (c == 'q') ? CR_BQ : 0;
+    }
+    castling = static_cast<CastlingRights>(cr);
+  }
+  if (ep.size() == 2 && ep[0] >= 'a' && ep[0] <= 'h' && ep[1] >= '1' && ep[1] <= '8')
+    ep_square = 1ULL << ((ep[0] - 'a') + 8 * (ep[1] - '1'));
+  if (!hmc.empty())
+    fifty_half_moves = std::atoi(hmc.c_str());
+  if (!fmc.empty())
+    full_moves = std::atoi(fmc.c_str());
+}
+
 } // namespace Wyvern
@@ -4,6 +4,8 @@
 #include <bit>
 #include <vector>
 
+#include "nnue.h"
+#include "psqt.h"
 #include "types.h"
 #include "utils.h"
 #include "zobrist.h"
@@ -11,30 +13,89 @@
 namespace Wyvern
 {
 
+// material and piece-square sums for each colour, kept up to date by makeMove
+// so that the evaluation does not have to rescan the bitboards
+struct PsqtScores
+{
+  std::array<int, 2> middle_game;
+  std::array<int, 2> end_game;
+  std::array<int, 2> material; // pvals of every piece but the king
+  int phase;                   // phase_values of both colours together
+};
+
+// everything needed to undo one move, pushed by makeMove and popped by
+// unmakeMove
+struct StateInfo
+{
+  U64 zobrist;       // before the move
+  U64 pawn_key;      // before the move
+  PsqtScores scores; // before the move
+  U32 move;
+  U16 hmc;           // fifty move counter before the move
+  U8 castling;       // castling rights before the move
+  U8 captured;       // PieceType captured by the move
+  U8 ep_square;      // en passant square index before the move, 64 if none
+};
+
+constexpr int initial_state_capacity = 1024;
+
 class Position
 {
 private:
   std::array<U64, 2> piece_colors;
   U64 ep_square;
   std::array<U64, 6> pieces;
+  // PieceType on each square, kept in step with the bitboards
+  std::array<U8, 64> board;
   enum CastlingRights castling;
   enum Color tomove;
   int fifty_half_moves;
   int full_moves;
   U64 zobrist;
-  std::vector<U64> position_history;
-  std::vector<enum CastlingRights> cr_history;
-  std::vector<int> hmc_history;
+  // zobrist key of the pawns alone, for the evaluator's pawn hash
+  U64 pawn_key;
+  PsqtScores scores;
+  // undo stack indexed by ply since construction. preallocated, and only
+  // grown in games longer than initial_state_capacity plies. copies hold just
+  // the plies played, until their first makeMove.
+  std::vector<StateInfo> states = std::vector<StateInfo>(initial_state_capacity);
+  int game_ply = 0;
+  // nnue accumulators indexed by ply like states, kept only while a network is
+  // set. those below nnue_base_ply predate the network, so unmakeMove
+  // refreshes them when it goes back that far.
+  const NnueNetwork* network = nullptr;
+  std::vector<NnueAccumulator> accumulators;
+  int nnue_base_ply = 0;
+  NnueDelta nnue_delta;
+
+  void refreshBoard();
+  void parseFenFields(const char* fen);
+  void refreshScores();
+  // keep the scores and the nnue delta in step with a piece arriving on or
+  // leaving sq
+  void pieceAdded(int color, int pt, int sq);
+  void pieceRemoved(int color, int pt, int sq);
+  // the accumulator for the ply just made, from the last one and nnue_delta
+  void updateAccumulator();
 
 public:
-  std::vector<U64>::const_reverse_iterator positionHistoryIteratorBegin() const;
-  std::vector<U64>::const_reverse_iterator positionHistoryIteratorEnd() const;
-  std::vector<U32> move_history;
+  int getGamePly() const;
+  // move played plies_ago plies back, 1 being the last move
+  U32 getHistoryMove(int plies_ago) const;
+  // zobrist key plies_ago plies back, 1 being the position before the last move
+  U64 getHistoryZobrist(int plies_ago) const;
   Position();
+  // a full fen, or just its piece placement for white to move with all
+  // castling rights
   Position(const char* fen);
   ~Position() = default;
-  Position(const Position& pos) = default;
+  Position(const Position& pos);
+  Position(Position&& pos) = default;
+  // trims the undo stack like the copy constructor
+  Position& operator=(const Position& pos);
+  Position& operator=(Position&& pos) = default;
   void zobristHash();
+  // also takes MOVE_NULL, passing the turn; never in check
   int makeMove(U32 move);
   int unmakeMove();
   void printFen();
@@ -42,12 +103,21 @@ public:
   int getHMC() const;
   int getFMC() const;
   U64 getZobrist() const;
+  U64 getPawnKey() const;
   enum CastlingRights getCR() const;
   const U64* getPieceColors() const;
   const U64* getPieces() const;
   enum Color getToMove() const;
+  const U8* getBoard() const;
+  const PsqtScores& getScores() const;
+  // keeps nnue accumulators for net from this ply on, or stops with nullptr.
+  // net must outlive its use here.
+  void setNetwork(const NnueNetwork* net);
+  const NnueNetwork* getNetwork() const;
+  // only while a network is set
+  const NnueAccumulator& getAccumulator() const;
   int checkValidity();
-  enum PieceType pieceAtSquare(U64 sq);
+  enum PieceType pieceAtSquare(U64 sq) const;
   U64 getEpSquare();
   bool operator==(const Position& pos) const
   {
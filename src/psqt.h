@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+
+#include "types.h"
+
+namespace Wyvern
+{
+
+constexpr int pval_pawn = 100;
+constexpr int pval_knight = 315;
+constexpr int pval_bishop = 330;
+constexpr int pval_rook = 500;
+constexpr int pval_queen = 900;
+
+constexpr int pvals[6] = {pval_pawn, pval_knight, pval_bishop,
+                          pval_rook, pval_queen,  20000}; // king has absurd value for see
+
+// material counted towards the game phase, in pawns; the king counts for none
+constexpr int phase_values[6] = {1, 3, 3, 5, 9, 0};
+
+// piece-square tables, indexed by square from white's side of the board
+
+constexpr int place_value_pawn[64] = {
+  0,  0,  0,  0,  0,  0,  0,  0,  5,  10, 10, -20, -20, 10, 10, 5,  5, -5, -5, 0,  0,  -10,
+  -5, 5,  0,  0,  5,  20, 20, 0,  0,  0,  5,  5,   10,  25, 25, 10, 5, 5,  10, 10, 20, 30,
+  30, 20, 10, 10, 50, 50, 50, 50, 50, 50, 50, 50,  0,   0,  0,  0,  0, 0,  0,  0};
+
+constexpr int place_value_knight[64] = {
+  -50, -40, -30, -30, -30, -30, -40, -50, -40, -20, 0,   0,   0,   0,   -20, -40,
+  -30, 5,   10,  15,  15,  10,  5,   -30, -30, 0,   15,  20,  20,  15,  0,   -30,
+  -30, 5,   15,  20,  20,  15,  5,   -30, -30, 0,   10,  15,  15,  10,  0,   -30,
+  -40, -20, 0,   5,   5,   0,   -20, -40, -50, -40, -30, -30, -30, -30, -40, -50};
+
+constexpr int place_value_bishop[64] = {
+  -20, -10, -10, -10, -10, -10, -10, -20, -10, 0,   0,   0,   0,   0,   0,   -10,
+  -10, 10,  10,  10,  10,  10,  10,  -10, -10, 0,   10,  10,  10,  10,  0,   -10,
+  -10, 5,   5,   10,  10,  5,   5,   -10, -10, 0,   5,   10,  10,  5,   0,   -10,
+  -10, 5,   0,   0,   0,   0,   5,   -10, -20, -10, -10, -10, -10, -10, -10, -20};
+
+constexpr int place_value_rook[64] = {0,  0,  0,  5,  5,  0,  0,  0,  -5, 0, 0, 0, 0, 0, 0, -5,
+                                      -5, 0,  0,  0,  0,  0,  0,  -5, -5, 0, 0, 0, 0, 0, 0, -5,
+                                      -5, 0,  0,  0,  0,  0,  0,  -5, -5, 0, 0, 0, 0, 0, 0, -5,
+                                      5,  10, 10, 10, 10, 10, 10, 5,  0,  0, 0, 0, 0, 0, 0, 0};
+
+constexpr int place_value_queen[64] = {-20, -10, -10, -5,  -5,  -10, -10, -20, -10, 0,   5,   0,  0,
+                                       0,   0,   -10, -10, 5,   5,   5,   5,   5,   0,   -10, 0,  0,
+                                       5,   5,   5,   5,   0,   -5,  -5,  0,   5,   5,   5,   5,  0,
+                                       -5,  -10, 0,   5,   5,   5,   5,   0,   -10, -10, 0,   0,  0,
+                                       0,   0,   0,   -10, -20, -10, -10, -5,  -5,  -10, -10, -20};
+
+constexpr int king_middle_game[64] = {
+  20,  30,  10,  0,   0,   10,  30,  20,  20,  20,  0,   0,   0,   0,   20,  20,
+  -10, -20, -20, -20, -20, -20, -20, -10, -20, -30, -30, -40, -40, -30, -30, -20,
+  -30, -40, -40, -50, -50, -40, -40, -30, -30, -40, -40, -50, -50, -40, -40, -30,
+  -30, -40, -40, -50, -50, -40, -40, -30, -30, -40, -40, -50, -50, -40, -40, -30};
+
+constexpr int king_end_game[64] = {-50, -30, -30, -30, -30, -30, -30, -50, -30, -30, 0,   0,   0,
+                                   0,   -30, -30, -30, -10, 20,  30,  30,  20,  -10, -30, -30, -10,
+                                   30,  40,  40,  30,  -10, -30, -30, -10, 30,  40,  40,  30,  -10,
+                                   -30, -30, -10, 20,  30,  30,  20,  -10, -30, -30, -20, -10, 0,
+                                   0,   -10, -20, -30, -50, -40, -30, -20, -20, -30, -40, -50};
+
+constexpr const int* psqt_middle_game[6] = {place_value_pawn, place_value_knight,
+                                            place_value_bishop, place_value_rook,
+                                            place_value_queen, king_middle_game};
+constexpr const int* psqt_end_game[6] = {place_value_pawn, place_value_knight,
+                                         place_value_bishop, place_value_rook,
+                                         place_value_queen, king_end_game};
+
+// square p as seen from color's side of the board
+constexpr int psqtSquare(int color, int p)
+{
+  return color ? (p & 7) + 56 - (p & 56) : p;
+}
+
+// what one piece on one square adds to its side's PsqtScores, indexed by
+// [color][piece index][square]
+struct PsqtEntry
+{
+  int middle_game;
+  int end_game;
+  int material;
+  int phase;
+};
+
+constexpr auto psqt_entries = []()
+{
+  std::array<std::array<std::array<PsqtEntry, 64>, 6>, 2> entries{};
+  for (int color = 0; color < 2; color++)
+  {
+    for (int pt = 0; pt < 6; pt++)
+    {
+      for (int sq = 0; sq < 64; sq++)
+      {
+        int p = psqtSquare(color, sq);
+        entries[color][pt][sq] = {psqt_middle_game[pt][p], psqt_end_game[pt][p],
+                                  (pt == KING - 1) ? 0 : pvals[pt], phase_values[pt]};
+      }
+    }
+  }
+  return entries;
+}();
+
+} // namespace Wyvern
@@ -1,5 +1,8 @@
 #include "search.h"
+#include <cstdlib>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
 namespace Wyvern
 {
@@ -10,15 +13,33 @@ template BoundedEval Search::negamax<COLOR_BLACK>(Position&, int, int, int, bool
 U32 Search::bestmove(Position pos, double t_limit, int max_basic_depth,
                      [[maybe_unused]] int max_depth_hard, int& out_eval)
 {
-  current_depth = 0;
-  max_depth = 0;
-  node_count = 0;
-  node_count_qs = 0;
-  table_hits = 0;
-  init_time = time(nullptr);
-  time_limit = t_limit;
+  GoLimits limits;
+  limits.movetime = std::max(static_cast<int>(t_limit * 1000), 1);
+  limits.depth = max_basic_depth;
+  startClock(limits, pos.getToMove());
+  return bestmove(pos, limits, out_eval);
+}
+
+void Search::startClock(const GoLimits& limits, enum Color side)
+{
+  timeman.start(limits, side);
+}
+
+U32 Search::bestmove(Position pos, const GoLimits& limits, int& out_eval)
+{
+  stop_flag->store(false, std::memory_order_relaxed);
+  node_limit = limits.nodes;
+  int max_basic_depth =
+    (limits.depth > 0) ? std::min(limits.depth, max_search_depth) : max_search_depth;
+  ttable->ensureAllocated(getThreads());
+  ttable->newSearch();
+  resetCounters();
+  move_history.newSearch();
+  // the helpers copy pos, accumulators included
+  if (evaluator.getNetwork())
+    pos.setNetwork(evaluator.getNetwork().get());
   enum Color player_turn = pos.getToMove();
-  std::vector<U32> moves;
+  MoveList moves;
   if (player_turn)
     movegen.generateMoves<COLOR_BLACK>(pos, true, moves);
   else
@@ -28,155 +49,435 @@ U32 Search::bestmove(Position pos, double t_limit, int max_basic_depth,
     return MOVE_NONE;
   if (moves.size() == 1)
   {
-    std::cout << "single legal move" << std::endl;
+    if (!uci_output)
+      std::cout << "single legal move" << std::endl;
     return moves.back();
   }
 
-  std::vector<BoundedEval> b_evals(moves.size());
+  std::vector<std::thread> threads;
+  for (auto& helper : helpers)
+  {
+    helper->resetCounters();
+    helper->move_history.newSearch();
+    threads.emplace_back(
+      [&helper, pos, moves, max_basic_depth]() mutable
+      {
+        BoundedEval helper_eval;
+        helper->iterate(pos, moves, max_basic_depth, helper_eval);
+      });
+  }
+
+  BoundedEval best_eval(BOUND_UPPER, -INT32_MAX);
+  U32 best_move = iterate(pos, moves, max_basic_depth, best_eval);
+
+  stop_flag->store(true, std::memory_order_relaxed);
+  for (auto& t : threads)
+    t.join();
+  total_nodes = node_count;
+  for (auto& helper : helpers)
+  {
+    total_nodes += helper->node_count;
+    table_hits += helper->table_hits;
+    table_probes += helper->table_probes;
+    eval_hits += helper->eval_hits;
+    eval_probes += helper->eval_probes;
+    cutoffs += helper->cutoffs;
+    first_move_cutoffs += helper->first_move_cutoffs;
+  }
+  if (!uci_output)
+    printStats();
+  out_eval = best_eval.eval;
+  return (best_move);
+}
+
+// iterative deepening over the root moves. helpers start on alternate depths
+// so that the threads spread out over the tree instead of searching in step.
+U32 Search::iterate(Position& pos, MoveList& moves, int max_basic_depth, BoundedEval& out_eval)
+{
+  enum Color player_turn = pos.getToMove();
+  EvalList b_evals;
   U32 best_move = MOVE_NONE;
+  U32 previous_best_move = MOVE_NONE;
   BoundedEval best_eval(BOUND_UPPER, -INT32_MAX);
 
-  for (int id_d = 0; (difftime(time(nullptr), init_time) < time_limit && id_d < max_basic_depth) ||
-                     (best_move == MOVE_NONE);
+  for (int id_d = thread_id % 2;
+       (!timeUp() && id_d < max_basic_depth) || (best_move == MOVE_NONE && thread_id == 0);
        id_d++)
   {
-    int t_alpha = -INT32_MAX; // temporary value of alpha for ids
-    int i = 0;
-    BoundedEval best_eval_id(BOUND_UPPER, -INT32_MAX);
-    for (U32 move : moves)
+    // aspiration: a window around the last iteration's eval, widened on the
+    // side the result falls out of until it lands inside
+    int delta = aspiration_delta;
+    int alpha = -INT32_MAX;
+    int beta = INT32_MAX;
+    if (aspiration && id_d >= aspiration_min_depth && std::abs(best_eval.eval) < mate_threshold)
+    {
+      alpha = std::max(best_eval.eval - delta, -INT32_MAX);
+      beta = std::min(best_eval.eval + delta, INT32_MAX);
+    }
+    BoundedEval best_eval_id;
+    while (true)
     {
-      pos.makeMove(move);
-      BoundedEval val;
-      if (player_turn == COLOR_WHITE)
-        val = -negamax<COLOR_BLACK>(pos, id_d, -INT32_MAX, -t_alpha, true, id_d + 4);
+      best_eval_id = searchRoot(pos, moves, b_evals, id_d, alpha, beta);
+      if (timeUp())
+        break;
+      if (best_eval_id.eval <= alpha && alpha > -INT32_MAX)
+        alpha = static_cast<int>(std::max<long long>(1LL * alpha - delta, -INT32_MAX));
+      else if (best_eval_id.eval >= beta && beta < INT32_MAX)
+        beta = static_cast<int>(std::min<long long>(1LL * beta + delta, INT32_MAX));
       else
-        val = -negamax<COLOR_WHITE>(pos, id_d, -INT32_MAX, -t_alpha, true, id_d + 4);
-      pos.unmakeMove();
-
-      if (val.eval > best_eval_id.eval)
-        best_eval_id = val;
-      if (val.eval > t_alpha && val.bound != BOUND_UPPER)
-        t_alpha = val.eval;
-      if (difftime(time(nullptr), init_time) >= time_limit && best_move != MOVE_NONE)
-      {
         break;
-      }
-      b_evals[i] = val;
-      i++;
+      delta = std::min(delta, INT32_MAX / 4) * 2;
     }
-    if (difftime(time(nullptr), init_time) >= time_limit)
+    // the main thread always finishes its first iteration, so that it has a
+    // move to return however early it is stopped
+    if (timeUp() && (best_move != MOVE_NONE || thread_id != 0))
       break;
     sortMoves(moves, b_evals);
     best_eval = best_eval_id;
     if (best_eval.eval >= INT32_MAX - 100)
     {
-      for (size_t i = 0; i < b_evals.size(); ++i)
+      for (size_t i = 0; i < moves.size(); ++i)
       {
         if (b_evals[i] == best_eval)
           best_move = moves[i];
       }
+      if (thread_id == 0 && uci_output)
+        printInfo(pos, id_d + 1, best_eval, best_move);
       break; // go for forced mate if available
     }
-    for (size_t i = 0; i < b_evals.size(); ++i)
+    for (size_t i = 0; i < moves.size(); ++i)
     {
       if (b_evals[i] == best_eval)
         best_move = moves[i];
     }
-    std::cout << "IDS value @depth=" << id_d << " == " << -(2 * player_turn - 1) * best_eval.eval
-              << ": move=";
-    printSq(best_move & 63);
-    printSq((best_move >> 6) & 63);
-    std::cout << "\n";
+    if (thread_id != 0)
+      continue;
+    if (uci_output)
+      printInfo(pos, id_d + 1, best_eval, best_move);
+    else
+    {
+      std::cout << "IDS value @depth=" << id_d << " == " << -(2 * player_turn - 1) * best_eval.eval
+                << ": move=";
+      printSq(best_move & 63);
+      printSq((best_move >> 6) & 63);
+      std::cout << "\n";
+    }
+    if (previous_best_move != MOVE_NONE)
+      timeman.iterationDone(best_move != previous_best_move);
+    previous_best_move = best_move;
+    // another iteration would likely not finish in time
+    if (timeman.softExpired())
+      break;
   }
-  printStats();
-  out_eval = best_eval.eval;
-  return (best_move);
+  out_eval = best_eval;
+  return best_move;
 }
 
-void Search::printStats()
+void Search::resetCounters()
 {
-  std::cout << "Nodes total = " << node_count << ", Quiesce = " << node_count_qs
-            << ", Max depth = " << max_depth << ", Table hits = " << table_hits << std::endl;
+  current_depth = 0;
+  max_depth = 0;
+  node_count = 0;
+  node_count_qs = 0;
+  table_hits = 0;
+  table_probes = 0;
+  eval_hits = 0;
+  eval_probes = 0;
+  cutoffs = 0;
+  first_move_cutoffs = 0;
+  total_nodes = 0;
+  evaluator.resetStats();
+  clock_countdown = clock_check_interval;
+}
+
+// the clock is read only every clock_check_interval calls, and by the main
+// thread alone; the stop flag it sets is what the helpers see
+bool Search::timeUp()
+{
+  if (stop_flag->load(std::memory_order_relaxed))
+    return true;
+  if (thread_id != 0)
+    return false;
+  bool out_of_nodes = node_limit && node_count >= node_limit;
+  if (!out_of_nodes && --clock_countdown > 0)
+    return false;
+  clock_countdown = clock_check_interval;
+  if (!out_of_nodes && !timeman.hardExpired())
+    return false;
+  stop_flag->store(true, std::memory_order_relaxed);
+  return true;
+}
+
+void Search::stop()
+{
+  stop_flag->store(true, std::memory_order_relaxed);
 }
 
-U64 Search::perft(Position& pos, int depth, int* n_capts, int* n_enpass, int* n_promo,
-                  int* n_castles, int* checks)
+void Search::ponderhit()
 {
+  timeman.ponderhit();
+}
 
-  if (pos.checkValidity())
+void Search::setUciOutput(bool enabled)
+{
+  uci_output = enabled;
+}
+
+std::vector<U32> Search::principalVariation(Position pos, U32 best_move, int max_length)
+{
+  std::vector<U32> pv;
+  std::vector<U64> seen;
+  U32 move = best_move;
+  while (move != MOVE_NONE && (int)pv.size() < max_length)
   {
-    pos.printPretty();
-    for (U32 move : pos.move_history)
-    {
-      std::cout << std::hex << (move >> 12) << "|";
-      printSq(move & 63);
-      printSq((move >> 6) & 63);
-      std::cout << " -> ";
-    }
-    std::cout << "\n";
-    std::cin.get();
+    MoveList moves;
+    if (pos.getToMove() == COLOR_WHITE)
+      movegen.generateMoves<COLOR_WHITE>(pos, true, moves);
+    else
+      movegen.generateMoves<COLOR_BLACK>(pos, true, moves);
+    if (std::find(moves.begin(), moves.end(), move) == moves.end())
+      break;
+    pv.push_back(move);
+    seen.push_back(pos.getZobrist());
+    pos.makeMove(move);
+    // a repetition would go round the same hash moves for ever
+    if (std::find(seen.begin(), seen.end(), pos.getZobrist()) != seen.end())
+      break;
+    move = MOVE_NONE;
+    ttable->lookup(pos.getZobrist(), 0, &move);
   }
-  const U64* pcols = pos.getPieceColors();
-  const U64* pcs = pos.getPieces();
-  enum Color ct = pos.getToMove();
-  int black_kp = std::countr_zero(pcs[KING - 1] & pcols[1]);
-  int white_kp = std::countr_zero(pcs[KING - 1] & pcols[0]);
-  // if (std::popcount(pcs[KING-1] & pcols[0]) != 1) return 1;
-  // if (std::popcount(pcs[KING-1] & pcols[1]) != 1) return 1;
-  U64 bk_attack = movegen.squareAttackedBy<COLOR_WHITE>(black_kp, pos, 0);
-  U64 wk_attack = movegen.squareAttackedBy<COLOR_BLACK>(white_kp, pos, 0);
-
-  U64 checkers = (ct) ? bk_attack : wk_attack;
-  if (depth == 0)
+  return pv;
+}
+
+// scores are from the side to move; mates are counted in moves, negative when
+// it is the side to move that is mated. written in one piece so that lines
+// from another thread cannot land in the middle
+void Search::printInfo(Position& pos, int depth, BoundedEval eval, U32 best_move)
+{
+  U64 ms = static_cast<U64>(timeman.elapsedMs());
+  std::ostringstream info;
+  info << "info depth " << depth << " seldepth " << max_depth << " score ";
+  if (eval.eval >= INT32_MAX - 100)
+    info << "mate " << (INT32_MAX - eval.eval + 2) / 2;
+  else if (eval.eval <= 100 - INT32_MAX)
+    info << "mate -" << (eval.eval + INT32_MAX + 1) / 2;
+  else
+    info << "cp " << eval.eval;
+  info << " nodes " << node_count << " nps " << node_count * 1000 / (ms + 1) << " time " << ms
+       << " pv";
+  for (U32 move : principalVariation(pos, best_move, depth))
+    info << " " << moveString(move);
+  info << "\n";
+  std::cout << info.str() << std::flush;
+}
+
+void Search::setThreads(int n)
+{
+  if (n < 1)
+    n = 1;
+  helpers.clear();
+  for (int i = 1; i < n; i++)
   {
-    if (checkers)
-      (*checks)++;
-    return 1;
+    helpers.emplace_back(new Search(mt, ttable, evalcache, stop_flag, i));
+    helpers.back()->hash_move_ordering = hash_move_ordering;
+    helpers.back()->pvs = pvs;
+    helpers.back()->aspiration = aspiration;
+    helpers.back()->null_move = null_move;
+    helpers.back()->null_move_verification = null_move_verification;
+    helpers.back()->move_ordering = move_ordering;
+    helpers.back()->evaluator.setNetwork(evaluator.getNetwork());
   }
-  int sum = 0;
-  std::vector<U32> moves;
-  if (ct == COLOR_WHITE)
-    movegen.generateMoves<COLOR_WHITE>(pos, true, moves);
-  if (ct == COLOR_BLACK)
-    movegen.generateMoves<COLOR_BLACK>(pos, true, moves);
+}
 
-  for (U32 move : moves)
+int Search::getThreads() const
+{
+  return 1 + static_cast<int>(helpers.size());
+}
+
+void Search::setHashMoveOrdering(bool enabled)
+{
+  hash_move_ordering = enabled;
+  for (auto& helper : helpers)
+    helper->hash_move_ordering = enabled;
+}
+
+void Search::setPrincipalVariationSearch(bool enabled)
+{
+  pvs = enabled;
+  for (auto& helper : helpers)
+    helper->pvs = enabled;
+}
+
+void Search::setAspirationWindows(bool enabled)
+{
+  aspiration = enabled;
+  for (auto& helper : helpers)
+    helper->aspiration = enabled;
+}
+
+void Search::setNullMovePruning(bool enabled)
+{
+  null_move = enabled;
+  for (auto& helper : helpers)
+    helper->null_move = enabled;
+}
+
+void Search::setNullMoveVerification(bool enabled)
+{
+  null_move_verification = enabled;
+  for (auto& helper : helpers)
+    helper->null_move_verification = enabled;
+}
+
+void Search::setMoveOrdering(bool enabled)
+{
+  move_ordering = enabled;
+  for (auto& helper : helpers)
+    helper->move_ordering = enabled;
+}
+
+void Search::setHashSize(size_t mb)
+{
+  ttable->resize(mb, true, getThreads());
+}
+
+void Search::clearHash()
+{
+  // a table allocated here is already clear
+  if (!ttable->ensureAllocated(getThreads()))
+    ttable->clear(getThreads());
+  evalcache->clear();
+  move_history.clear();
+  for (auto& helper : helpers)
+    helper->move_history.clear();
+}
+
+void Search::setEvalCacheSize(size_t kb)
+{
+  evalcache->resize(kb);
+}
+
+void Search::setNetwork(std::shared_ptr<const NnueNetwork> net)
+{
+  evaluator.setNetwork(net);
+  for (auto& helper : helpers)
+    helper->evaluator.setNetwork(net);
+  evalcache->clear();
+}
+
+bool Search::loadNetwork(const std::string& path)
+{
+  auto net = std::make_shared<NnueNetwork>();
+  if (!net->load(path))
+    return false;
+  setNetwork(net);
+  return true;
+}
+
+int Search::staticEval(const Position& pos)
+{
+  ++eval_probes;
+  int eval;
+  if (evalcache->lookup(pos.getZobrist(), eval))
   {
+    ++eval_hits;
+    return eval;
+  }
+  eval = evaluator.evalPositional(pos);
+  evalcache->insert(pos.getZobrist(), eval);
+  return eval;
+}
 
-    /*
-    for (int indent = 0; indent < max_depth - depth; indent++) {
-      std::cout << " - ";
+U64 Search::getQuiesceNodeCount() const
+{
+  return node_count_qs;
+}
+
+U64 Search::getNodeCount() const
+{
+  return total_nodes;
+}
+
+double Search::getFirstMoveCutoffRate() const
+{
+  return cutoffs ? static_cast<double>(first_move_cutoffs) / cutoffs : 0.0;
+}
+
+void Search::printStats()
+{
+  std::cout << "Nodes total = " << total_nodes << " (" << getThreads()
+            << " threads), Main thread = " << node_count << ", Quiesce = " << node_count_qs
+            << ", Max depth = " << max_depth << std::endl;
+  std::cout << "Table hits = " << table_hits << "/" << table_probes << " ("
+            << ((table_probes) ? 100.0 * table_hits / table_probes : 0.0)
+            << "%), Table full = " << ttable->hashfull() / 10.0 << "%" << std::endl;
+  std::cout << "Eval cache hits = " << eval_hits << "/" << eval_probes << " ("
+            << ((eval_probes) ? 100.0 * eval_hits / eval_probes : 0.0) << "%)" << std::endl;
+  std::cout << "Beta cutoffs = " << cutoffs << ", on the first move = " << first_move_cutoffs
+            << " (" << 100.0 * getFirstMoveCutoffRate() << "%)" << std::endl;
+  U64 pawn_hits = evaluator.getPawnHits();
+  U64 pawn_probes = evaluator.getPawnProbes();
+  for (auto& helper : helpers)
+  {
+    pawn_hits += helper->evaluator.getPawnHits();
+    pawn_probes += helper->evaluator.getPawnProbes();
+  }
+  std::cout << "Pawn hash hits = " << pawn_hits << "/" << pawn_probes << " ("
+            << ((pawn_probes) ? 100.0 * pawn_hits / pawn_probes : 0.0) << "%)" << std::endl;
+}
+
+BoundedEval Search::searchRoot(Position& pos, MoveList& moves, EvalList& b_evals, int id_d,
+                              int alpha, int beta)
+{
+  enum Color player_turn = pos.getToMove();
+  std::fill_n(b_evals.begin(), moves.size(), BoundedEval(BOUND_UPPER, -INT32_MAX));
+  int t_alpha = alpha; // temporary value of alpha for ids
+  int i = 0;
+  BoundedEval best_eval(BOUND_UPPER, -INT32_MAX);
+  for (U32 move : moves)
+  {
+    bool scout = pvs && i > 0 && t_alpha < beta - 1;
+    int scout_beta = scout ? t_alpha + 1 : beta;
+    pos.makeMove(move);
+    BoundedEval val;
+    if (player_turn == COLOR_WHITE)
+    {
+      val = -negamax<COLOR_BLACK>(pos, id_d, -scout_beta, -t_alpha, true, id_d + 4);
+      if (scout && val.eval > t_alpha && val.eval < beta)
+        val = -negamax<COLOR_BLACK>(pos, id_d, -beta, -t_alpha, true, id_d + 4);
     }
-    printSq(move & 63); printSq((move >> 6) & 63); std::cout << std::endl;
-    */
-    if (depth == 1)
+    else
     {
-      if (move & YES_CAPTURE)
-        ++(*n_capts);
-      if ((move & MOVE_SPECIAL) == ENPASSANT)
-      {
-        ++(*n_enpass);
-        ++(*n_capts);
-      }
-      if ((move & MOVE_SPECIAL) == PROMO)
-        ++(*n_promo);
-      if ((move & MOVE_SPECIAL) == CASTLES)
-        ++(*n_castles);
+      val = -negamax<COLOR_WHITE>(pos, id_d, -scout_beta, -t_alpha, true, id_d + 4);
+      if (scout && val.eval > t_alpha && val.eval < beta)
+        val = -negamax<COLOR_WHITE>(pos, id_d, -beta, -t_alpha, true, id_d + 4);
     }
-    pos.makeMove(move);
-    sum += perft(pos, depth - 1, n_capts, n_enpass, n_promo, n_castles, checks);
     pos.unmakeMove();
+
+    // the main thread's first iteration is never cut short
+    if (timeUp() && (id_d > 0 || thread_id != 0))
+      break;
+    if (val.eval > best_eval.eval)
+      best_eval = val;
+    if (val.eval > t_alpha && val.bound != BOUND_UPPER)
+      t_alpha = val.eval;
+    b_evals[i] = val;
+    i++;
+    // failed high: the window is widened and the root searched again
+    if (val.eval >= beta)
+      break;
   }
-  return sum;
+  return best_eval;
 }
 
-void Search::sortMoves(std::vector<U32>& moves, std::vector<BoundedEval>& evals)
+void Search::sortMoves(MoveList& moves, EvalList& evals)
 {
   int lb_count = 0;
   int ub_count = 0;
   int exact_count = 0;
-  for (auto be : evals)
+  for (size_t i = 0; i < moves.size(); i++)
   {
+    BoundedEval be = evals[i];
     if (be.bound == BOUND_EXACT)
       exact_count++;
     if (be.bound == BOUND_UPPER)
@@ -191,7 +492,7 @@ void Search::sortMoves(std::vector<U32>& moves, std::vector<BoundedEval>& evals)
       if (evals[j].bound == BOUND_LOWER)
       {
         std::swap(evals[i], evals[j]);
-        std::swap(moves[i], moves[j]);
+        moves.swap(i, j);
         break;
       }
     }
@@ -206,24 +507,25 @@ void Search::sortMoves(std::vector<U32>& moves, std::vector<BoundedEval>& evals)
       {
         best = evals[j].eval;
         best_index = j;
-        break;
       }
     }
     std::swap(evals[i], evals[best_index]);
-    std::swap(moves[i], moves[best_index]);
+    moves.swap(i, best_index);
   }
 }
 
 bool Search::checkThreeReps(const Position& pos)
 {
-  auto begin = pos.positionHistoryIteratorBegin();
-  auto end = pos.positionHistoryIteratorEnd();
-  int hmc = pos.getHMC();
+  // positions before the last irreversible move cannot repeat, and those
+  // before a null move were not reached by the moves played
+  int plies = std::min(pos.getHMC(), pos.getGamePly());
   int count = 0;
   U64 z = pos.getZobrist();
-  for (auto iter = begin; iter != end && (begin - iter) < hmc; ++iter)
+  for (int i = 1; i <= plies; ++i)
   {
-    if (iter[0] == z)
+    if (pos.getHistoryMove(i) == MOVE_NULL)
+      break;
+    if (pos.getHistoryZobrist(i) == z)
       count++;
     if (count == 2)
       return true;
@@ -252,6 +554,22 @@ BoundedEval Search::bestEvalInVector(std::vector<BoundedEval>& b_evals)
     return best_ub;
 }
 
-Search::Search() : mt(std::make_shared<MagicTable>()), evaluator(mt), movegen(mt), ttable() {}
+Search::Search()
+    : Search(MagicTable::shared(), std::make_shared<TranspositionTable>(),
+             std::make_shared<EvalCache>(), std::make_shared<std::atomic<bool>>(false), 0)
+{
+}
+
+Search::Search(std::shared_ptr<const MagicTable> _mt, std::shared_ptr<TranspositionTable> _tt,
+               std::shared_ptr<EvalCache> _ec, std::shared_ptr<std::atomic<bool>> _stop,
+               int _thread_id)
+    : mt(_mt), evaluator(mt), movegen(mt), clock_countdown(clock_check_interval), node_limit(0),
+      uci_output(false), node_count(0), node_count_qs(0), table_hits(0), table_probes(0),
+      eval_hits(0), eval_probes(0), cutoffs(0), first_move_cutoffs(0), current_depth(0),
+      max_depth(0), qs_entry_depth(0), ttable(_tt), evalcache(_ec), thread_id(_thread_id),
+      stop_flag(_stop), total_nodes(0), hash_move_ordering(true), pvs(true), aspiration(true),
+      null_move(true), null_move_verification(true), move_ordering(true), null_move_min_ply(0)
+{
+}
 
 } // namespace Wyvern
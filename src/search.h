@@ -1,51 +1,180 @@
 #pragma once
 
+#include "evalcache.h"
 #include "evaluate.h"
 #include "movegen.h"
+#include "movepick.h"
+#include "perft.h"
 #include "position.h"
+#include "timeman.h"
 #include "transposition.h"
 #include "types.h"
-#include <ctime>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace Wyvern
 {
 
 constexpr int qs_depth_hardlimit = 30;
+constexpr int max_search_depth = 64;
+// half moves without a capture or pawn move, fifty for each side, that draw
+constexpr int fifty_move_plies = 100;
+// timeUp calls between looks at the clock
+constexpr int clock_check_interval = 1024;
+// half width of the first aspiration window, and the iteration it starts on
+constexpr int aspiration_delta = 30;
+constexpr int aspiration_min_depth = 3;
+// evals past this are mates, searched with the full window
+constexpr int mate_threshold = INT32_MAX - 100;
+// null move reduction at depth 2, one more ply every null_move_depth_step
+constexpr int null_move_reduction = 2;
+constexpr int null_move_depth_step = 4;
+// null move cutoffs from this depth on are checked by a search without one
+constexpr int null_move_verify_depth = 6;
+
+// per-move search results, kept on the stack alongside a MoveList
+using EvalList = std::array<BoundedEval, max_moves>;
 
 class Search
 {
 private:
-  std::shared_ptr<MagicTable> mt;
+  std::shared_ptr<const MagicTable> mt;
   Evaluator evaluator;
   MoveGenerator movegen;
-  void sortMoves(std::vector<U32>& moves, std::vector<BoundedEval>& evals);
-  template <enum Color CT> BoundedEval quiesce(Position pos, int alpha, int beta, int depth_hard);
-  time_t init_time;
-  time_t time_limit;
+  void sortMoves(MoveList& moves, EvalList& evals);
+  template <enum Color CT>
+  BoundedEval quiesce(Position& pos, int alpha, int beta, int depth_hard);
+  // the main thread keeps the time and sets the stop flag for the helpers
+  TimeManager timeman;
+  int clock_countdown;
+  // main thread nodes after which the search stops, 0 for no limit
+  U64 node_limit;
+  bool uci_output;
   BoundedEval bestEvalInVector(std::vector<BoundedEval>& b_evals);
   bool checkThreeReps(const Position& pos);
+  // true once the search should stop where it is
+  bool timeUp();
+  // counters belong to the thread running this Search; helpers have their own
   U64 node_count;
   U64 node_count_qs;
   U64 table_hits;
+  U64 table_probes;
+  U64 eval_hits;
+  U64 eval_probes;
+  // beta cutoffs in negamax, and those on the first move searched
+  U64 cutoffs;
+  U64 first_move_cutoffs;
   int current_depth;
   int max_depth;
-  TranspositionTable ttable;
-  void printStats();
   int qs_entry_depth;
+  std::shared_ptr<TranspositionTable> ttable;
+  std::shared_ptr<EvalCache> evalcache;
+  // evalPositional behind the shared eval cache
+  int staticEval(const Position& pos);
+  // lazy smp: helper searches share the table and stop flag with the main one
+  int thread_id;
+  std::shared_ptr<std::atomic<bool>> stop_flag;
+  std::vector<std::unique_ptr<Search>> helpers;
+  U64 total_nodes;
+  bool hash_move_ordering;
+  bool pvs;
+  bool aspiration;
+  bool null_move;
+  bool null_move_verification;
+  bool move_ordering;
+  MoveHistory move_history;
+  // no null move before this ply, set while a null move cutoff is verified
+  int null_move_min_ply;
+  template <enum Color CT>
+  bool nullMoveAllowed(Position& pos, int depth, int beta);
+  // one pass over the root moves with the window (alpha, beta)
+  BoundedEval searchRoot(Position& pos, MoveList& moves, EvalList& b_evals, int id_d, int alpha,
+                         int beta);
+  Search(std::shared_ptr<const MagicTable> _mt, std::shared_ptr<TranspositionTable> _tt,
+         std::shared_ptr<EvalCache> _ec, std::shared_ptr<std::atomic<bool>> _stop,
+         int _thread_id);
+  void resetCounters();
+  U32 iterate(Position& pos, MoveList& moves, int max_basic_depth, BoundedEval& out_eval);
+  void printStats();
+  // uci info line for the iteration that just finished at depth
+  void printInfo(Position& pos, int depth, BoundedEval eval, U32 best_move);
 
 public:
+  // cheap: shares the process-wide MagicTable, and allocates the transposition
+  // table on the first bestmove or clearHash
   Search();
+  void setThreads(int n);
+  int getThreads() const;
+  // search the stored hash move first and skip internal iterative deepening
+  // at nodes that have one
+  void setHashMoveOrdering(bool enabled);
+  // principal variation search: null windows for all but the first move at
+  // each node
+  void setPrincipalVariationSearch(bool enabled);
+  // search the root in a window around the last iteration's eval, widened
+  // when the result falls outside it
+  void setAspirationWindows(bool enabled);
+  // null move pruning: let the opponent move twice at reduced depth, and cut
+  // if that still fails high. never in check or in endgames, where zugzwang
+  // makes passing the best move
+  void setNullMovePruning(bool enabled);
+  // re-search deep null move cutoffs without null moves before trusting them
+  void setNullMoveVerification(bool enabled);
+  // order the quiet moves of a node by killers, countermove and history,
+  // behind the hash move and winning captures, and search every node once at
+  // full depth instead of deepening internally to sort its moves
+  void setMoveOrdering(bool enabled);
+  // reallocates the shared transposition table; only between searches
+  void setHashSize(size_t mb);
+  // also forgets the move ordering history
+  void clearHash();
+  // reallocates the shared eval cache, 0 (the default) to disable it; only
+  // between searches
+  void setEvalCacheSize(size_t kb);
+  // evaluate with an nnue network instead of the hand written evaluation, or
+  // go back to it with nullptr; clears the eval cache. only between searches
+  void setNetwork(std::shared_ptr<const NnueNetwork> net);
+  // loads a weight file and uses it; false, with the evaluation unchanged, if
+  // the file cannot be read
+  bool loadNetwork(const std::string& path);
+  // quiescence nodes searched by this thread, not reset outside bestmove
+  U64 getQuiesceNodeCount() const;
+  U64 getNodeCount() const;
+  // share of the beta cutoffs in the last bestmove that came on the first move
+  // searched, over all threads
+  double getFirstMoveCutoffRate() const;
+  // starts the clock for a search under limits. uci starts it as go arrives,
+  // before the search thread is up, so that a ponderhit cannot be missed
+  void startClock(const GoLimits& limits, enum Color side);
+  // searches to limits.depth plies (all of them if 0) within the node limit
+  // and the time of the clock last started
+  U32 bestmove(Position pos, const GoLimits& limits, int& out_eval);
+  // a search of t_limit seconds
   U32 bestmove(Position pos, double t_limit, int max_basic_depth, int max_depth_hard,
                int& out_eval);
+  // makes a bestmove running on another thread return as soon as it can.
+  // bestmove clears the flag as it starts, so a stop sent before then is lost
+  void stop();
+  // starts the clock of a bestmove started with limits.ponder
+  void ponderhit();
+  // print uci info lines for each iteration in place of the ids lines and
+  // the statistics
+  void setUciOutput(bool enabled);
+  // the best move followed by the table's hash moves, as far as they are legal
+  std::vector<U32> principalVariation(Position pos, U32 best_move, int max_length);
+  // runs without a transposition table until bestmove or clearHash allocates it
   template <enum Color CT>
   BoundedEval negamax(Position& pos, int depth, int alpha, int beta, bool do_quiesce, int d_max);
   ~Search() = default;
-  U64 perft(Position& pos, int depth, int* n_capts, int* n_enpass, int* n_promo, int* n_castles,
-            int* checks);
+  PerftCounters perft(Position& pos, int depth, const PerftOptions& options = PerftOptions());
 };
 
 template <enum Color CT>
-BoundedEval Search::quiesce(Position pos, int alpha, int beta, int depth_hard)
+BoundedEval Search::quiesce(Position& pos, int alpha, int beta, int depth_hard)
 {
   if (current_depth > max_depth)
     max_depth = current_depth;
@@ -54,20 +183,20 @@ BoundedEval Search::quiesce(Position pos, int alpha, int beta, int depth_hard)
   constexpr enum Color CTO = (enum Color)(CT ^ 1);
   U64 checks = movegen.inCheck(pos);
 
-  std::vector<U32> moves;
+  MoveList moves;
   if (checks)
     movegen.generateMoves<CT>(pos, true, moves);
   else
     movegen.generateMoves<CT>(pos, false, moves);
 
   // if in check any move that avoids mate is good
-  int stand_pat = (checks) ? -INT32_MAX : evaluator.evalPositional(pos);
+  int stand_pat = (checks) ? -INT32_MAX : staticEval(pos);
 
   int stand_pat_initial = stand_pat;
 
   if (moves.size() == 0)
   {
-    std::vector<U32> temp;
+    MoveList temp;
     movegen.generateMoves<CT>(pos, true, temp); // generate more moves to check for mate/stalemate
     if (checks && temp.size() == 0)
       return BoundedEval(BOUND_EXACT, -INT32_MAX);
@@ -75,12 +204,15 @@ BoundedEval Search::quiesce(Position pos, int alpha, int beta, int depth_hard)
       return BoundedEval(BOUND_EXACT, 0); // stalemate
     // not stalemate, no captures, return stand pat
   }
-  if (pos.getHMC() >= 50)
+  if (pos.getHMC() >= fifty_move_plies)
     return BoundedEval(BOUND_EXACT, 0);
   if (checkThreeReps(pos))
     return BoundedEval(BOUND_EXACT, 0);
   if (moves.size() == 0)
     return BoundedEval(BOUND_EXACT, stand_pat);
+  // standing pat is already good enough
+  if (stand_pat >= beta)
+    return BoundedEval(BOUND_LOWER, stand_pat);
   alpha = (alpha > stand_pat) ? alpha : stand_pat; // baseline score
   enum Bound bound = (alpha > stand_pat) ? BOUND_UPPER : BOUND_EXACT;
 
@@ -95,7 +227,8 @@ BoundedEval Search::quiesce(Position pos, int alpha, int beta, int depth_hard)
   // collision possibility
   if (current_depth - qs_entry_depth < 4)
   {
-    BoundedEval table_lookup = ttable.lookup(pos.getZobrist(), 0);
+    ++table_probes;
+    BoundedEval table_lookup = ttable->lookup(pos.getZobrist(), 0);
     if (table_lookup.bound != BOUND_INVALID)
     {
       ++table_hits;
@@ -166,7 +299,7 @@ BoundedEval Search::quiesce(Position pos, int alpha, int beta, int depth_hard)
   }
 
   if (current_depth - qs_entry_depth < 4)
-    ttable.insert(pos.getZobrist(), BoundedEval(bound, stand_pat), 0);
+    ttable->insert(pos.getZobrist(), BoundedEval(bound, stand_pat), 0);
   return BoundedEval(bound, stand_pat);
 }
 template <enum Color CT>
@@ -179,7 +312,7 @@ BoundedEval Search::negamax(Position& pos, int depth, int alpha, int beta, bool
   ++node_count;
   constexpr enum Color CTO = (enum Color)(CT ^ 1);
 
-  std::vector<U32> moves;
+  MoveList moves;
   movegen.generateMoves<CT>(pos, true, moves);
   if (moves.size() == 0)
   {
@@ -187,7 +320,7 @@ BoundedEval Search::negamax(Position& pos, int depth, int alpha, int beta, bool
       return BoundedEval(BOUND_EXACT, -INT32_MAX);
     return BoundedEval(BOUND_EXACT, 0);
   }
-  if (pos.getHMC() >= 50)
+  if (pos.getHMC() >= fifty_move_plies)
     return BoundedEval(BOUND_EXACT, 0);
   if (checkThreeReps(pos))
     return BoundedEval(BOUND_EXACT, 0);
@@ -196,7 +329,9 @@ BoundedEval Search::negamax(Position& pos, int depth, int alpha, int beta, bool
   // or exact this logic is needed if we are using aspirational windows must
   // always come after move generation for checkmate test due to zobrist hash
   // collision possibility
-  BoundedEval table_lookup = ttable.lookup(pos.getZobrist(), depth);
+  U32 hash_move = MOVE_NONE;
+  ++table_probes;
+  BoundedEval table_lookup = ttable->lookup(pos.getZobrist(), depth, &hash_move);
   if (table_lookup.bound != BOUND_INVALID)
   {
     ++table_hits;
@@ -221,22 +356,58 @@ BoundedEval Search::negamax(Position& pos, int depth, int alpha, int beta, bool
   if (depth == 0 || d_max == 0)
   {
     if (!do_quiesce)
-      return BoundedEval(BOUND_EXACT, evaluator.evalPositional(pos));
+      return BoundedEval(BOUND_EXACT, staticEval(pos));
     qs_entry_depth = current_depth;
     return quiesce<CT>(pos, alpha, beta, qs_depth_hardlimit);
   }
 
-  std::vector<BoundedEval> b_evals(moves.size(), BoundedEval(BOUND_UPPER, -INT32_MAX));
+  if (nullMoveAllowed<CT>(pos, depth, beta))
+  {
+    int reduction = null_move_reduction + depth / null_move_depth_step;
+    int null_depth = std::max(depth - 1 - reduction, 0);
+    pos.makeMove(MOVE_NULL);
+    current_depth++;
+    BoundedEval val = -negamax<CTO>(pos, null_depth, -beta, 1 - beta, do_quiesce, d_max - 1);
+    current_depth--;
+    pos.unmakeMove();
+    // a mate found after passing is not a mate
+    int null_eval = std::min(val.eval, mate_threshold - 1);
+    if (val.eval >= beta && !timeUp())
+    {
+      if (!null_move_verification || depth < null_move_verify_depth)
+        return BoundedEval(BOUND_LOWER, null_eval);
+      int outer_min_ply = null_move_min_ply;
+      null_move_min_ply = current_depth + 3 * (depth - reduction) / 4;
+      BoundedEval verified = negamax<CT>(pos, depth - reduction, beta - 1, beta, do_quiesce, d_max);
+      null_move_min_ply = outer_min_ply;
+      if (verified.eval >= beta)
+        return BoundedEval(BOUND_LOWER, null_eval);
+    }
+  }
+
+  // a hash move means this node has been searched before: try it first and go
+  // straight to the full depth instead of re-deepening to order the moves
+  MovePicker<CT> picker(moves, pos, evaluator, move_history, current_depth,
+                        hash_move_ordering ? hash_move : MOVE_NONE, move_ordering);
+  // the staged picker orders well enough that no node re-deepens with it
+  int first_id = (picker.hasHashMove() || move_ordering) ? depth - 1 : 0;
+
+  EvalList b_evals;
+  std::fill_n(b_evals.begin(), moves.size(), BoundedEval(BOUND_UPPER, -INT32_MAX));
 
   BoundedEval best_evaluation(BOUND_UPPER, -INT32_MAX);
-  // iterative deepening up to depth-2 to get promising move order
-  for (int id_d = 0; id_d < depth && difftime(time(nullptr), init_time) < time_limit; id_d++)
+  U32 best_move = MOVE_NONE;
+  // iterative deepening up to depth-2 to get promising move order, unless the
+  // picker orders the moves
+  for (int id_d = first_id; id_d < depth && !timeUp(); id_d++)
   {
     int t_alpha = alpha; // temporary value of alpha for ids
     int i = 0;
     BoundedEval best_eval_id(BOUND_UPPER, -INT32_MAX);
-    for (U32 move : moves)
+    U32 best_move_id = MOVE_NONE;
+    while (i < static_cast<int>(moves.size()))
     {
+      U32 move = picker.pick(i);
 
       current_depth++;
       int extension = 0;
@@ -268,7 +439,8 @@ BoundedEval Search::negamax(Position& pos, int depth, int alpha, int beta, bool
         lmr = true;
         extension = (id_d > 2 && i > 15) ? -2 : -1;
 
-        if (b_evals[i].eval < t_alpha && id_d >= 3 && i >= (int)moves.size() / 2)
+        if (b_evals[i].eval < t_alpha && id_d >= 3 && id_d > first_id &&
+            i >= (int)moves.size() / 2)
         {
           i++;
           current_depth--;
@@ -277,16 +449,22 @@ BoundedEval Search::negamax(Position& pos, int depth, int alpha, int beta, bool
         }
       }
 
+      // pvs: moves after the first only have to be shown no better than it,
+      // with a null window, and get the full window if they are
+      bool scout = pvs && i > 0 && t_alpha < beta - 1;
+      int scout_beta = scout ? t_alpha + 1 : beta;
       BoundedEval val =
-        -negamax<CTO>(pos, id_d + extension, -beta, -t_alpha, do_quiesce, d_max - 1);
+        -negamax<CTO>(pos, id_d + extension, -scout_beta, -t_alpha, do_quiesce, d_max - 1);
 
       if (val.eval >= t_alpha && lmr)
       {
         // if not a bad looking move re-search at unreduced depth for late move
         // reductions
         extension = 0;
-        val = -negamax<CTO>(pos, id_d, -beta, -t_alpha, do_quiesce, d_max - 1);
+        val = -negamax<CTO>(pos, id_d, -scout_beta, -t_alpha, do_quiesce, d_max - 1);
       }
+      if (scout && val.eval > t_alpha && val.eval < beta)
+        val = -negamax<CTO>(pos, id_d + extension, -beta, -t_alpha, do_quiesce, d_max - 1);
       pos.unmakeMove();
       --current_depth;
       // add 1 to "distance" if result is forced mate
@@ -295,7 +473,7 @@ BoundedEval Search::negamax(Position& pos, int depth, int alpha, int beta, bool
       if (val.eval >= INT32_MAX - 40)
         val.eval--;
 
-      if (difftime(time(nullptr), init_time) >= time_limit)
+      if (timeUp())
       {
         break;
       }
@@ -303,25 +481,66 @@ BoundedEval Search::negamax(Position& pos, int depth, int alpha, int beta, bool
       if (val.eval > t_alpha)
         t_alpha = val.eval;
       if (val.eval >= best_eval_id.eval)
+      {
         best_eval_id = val;
-      if (t_alpha >= beta && id_d > 0)
+        best_move_id = move;
+      }
+      // the depth 0 pass scores every move to sort them, unless it is the only one
+      if (t_alpha >= beta && (id_d > 0 || move_ordering))
       {
         b_evals[i].bound = BOUND_LOWER;
+        ++cutoffs;
+        if (i == 0)
+          ++first_move_cutoffs;
+        if (move_ordering && isQuiet(move))
+        {
+          U32 previous = (pos.getGamePly() > 0) ? pos.getHistoryMove(1) : MOVE_NONE;
+          move_history.cutoff(CT, current_depth, depth, previous, moves.begin(), i);
+        }
         break; // either continue ids or
       }
       i++;
     }
-    if (difftime(time(nullptr), init_time) >= time_limit)
+    if (timeUp())
     {
       break;
     }
     best_evaluation = best_eval_id;
+    best_move = best_move_id;
     sortMoves(moves, b_evals);
   }
-  if (best_evaluation.eval < alpha)
+  // a search cut short by the clock or by stop has no result worth keeping,
+  // and a stored one would poison the next search
+  if (timeUp())
+    return best_evaluation;
+  // the bound follows from the window the moves were searched with, as the
+  // table narrowed it: under null windows nearly every node fails one way or
+  // the other, and a bound taken over from a child would store a fail as exact
+  if (best_evaluation.eval <= alpha)
     best_evaluation.bound = BOUND_UPPER;
-  ttable.insert(pos.getZobrist(), best_evaluation, depth);
+  else if (best_evaluation.eval >= beta)
+    best_evaluation.bound = BOUND_LOWER;
+  else
+    best_evaluation.bound = BOUND_EXACT;
+  ttable->insert(pos.getZobrist(), best_evaluation, depth, best_move);
   return best_evaluation;
 }
 
+// passing is only tried where the side to move has pieces to spare and a
+// fail high is in reach: not in check, not after a null move, not against a
+// mate bound
+template <enum Color CT>
+bool Search::nullMoveAllowed(Position& pos, int depth, int beta)
+{
+  if (!null_move || depth < 2 || current_depth < null_move_min_ply)
+    return false;
+  if (beta >= mate_threshold || beta <= -mate_threshold)
+    return false;
+  if (pos.getGamePly() > 0 && pos.getHistoryMove(1) == MOVE_NULL)
+    return false;
+  if (evaluator.totalMaterial(pos) <= endgame_material_limit || movegen.inCheck(pos))
+    return false;
+  return staticEval(pos) >= beta;
+}
+
 } // namespace Wyvern
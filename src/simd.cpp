@@ -0,0 +1,20 @@
+#include "simd.h"
+
+namespace Wyvern
+{
+
+bool cpuHasAvx2()
+{
+#if defined(WYVERN_SIMD_AVX2)
+  static const bool has_avx2 = []()
+  {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+  }();
+  return has_avx2;
+#else
+  return false;
+#endif
+}
+
+} // namespace Wyvern
@@ -0,0 +1,30 @@
+#pragma once
+
+// x86-64 vector support shared by the vectorised kernels. avx2 kernels are
+// compiled with a target attribute and only called when the cpu has avx2, so
+// the build needs no -mavx2; sse2 is part of x86-64 and always there.
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define WYVERN_SIMD_X86
+#if defined(__GNUC__) || defined(__clang__)
+#define WYVERN_SIMD_AVX2
+#define WYVERN_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// a hint to bring addr's cache line in ahead of use
+#if defined(__GNUC__) || defined(__clang__)
+#define WYVERN_PREFETCH(addr) __builtin_prefetch(addr)
+#elif defined(WYVERN_SIMD_X86)
+#define WYVERN_PREFETCH(addr) _mm_prefetch(reinterpret_cast<const char*>(addr), _MM_HINT_T0)
+#else
+#define WYVERN_PREFETCH(addr)
+#endif
+
+namespace Wyvern
+{
+
+// whether avx2 kernels can run on this cpu; checked once
+bool cpuHasAvx2();
+
+} // namespace Wyvern
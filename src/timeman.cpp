@@ -0,0 +1,94 @@
+#include "timeman.h"
+#include <algorithm>
+
+namespace Wyvern
+{
+
+namespace
+{
+
+// soft limit factor by the number of iterations the best move has survived
+constexpr double stability_scale[] = {1.4, 1.1, 0.9, 0.8, 0.7};
+constexpr int max_stability = 4;
+// how far past the soft limit an iteration may run before it is cut off
+constexpr double hard_soft_ratio = 4;
+
+} // namespace
+
+// movetime is spent whole. a clock is shared evenly over the moves to go,
+// with most of the increment on top; the hard limit leaves half the clock
+// when more moves are to come
+void TimeManager::start(const GoLimits& limits, enum Color side)
+{
+  start_ticks.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+  pondering.store(limits.ponder, std::memory_order_relaxed);
+  soft_scale = 1.0;
+  stable_iterations = 0;
+  int time = (side == COLOR_WHITE) ? limits.wtime : limits.btime;
+  int inc = (side == COLOR_WHITE) ? limits.winc : limits.binc;
+  limited = !limits.infinite && (limits.movetime > 0 || time != no_clock);
+  if (limits.movetime > 0)
+  {
+    soft_ms = limits.movetime;
+    hard_ms = limits.movetime;
+    return;
+  }
+  // an empty or negative clock, as some guis send in overtime, still gets a
+  // limit: searching on unbounded would lose on time
+  if (time <= 0)
+  {
+    soft_ms = out_of_time_ms;
+    hard_ms = out_of_time_ms;
+    return;
+  }
+  int moves = (limits.movestogo > 0) ? limits.movestogo : default_moves_to_go;
+  double max_ms = std::max(time - move_overhead_ms, 1);
+  soft_ms = std::min(static_cast<double>(time) / moves + inc * 0.75, max_ms);
+  double cap = (moves > 1) ? max_ms / 2 : max_ms;
+  hard_ms = std::max(std::min(soft_ms * hard_soft_ratio, cap), soft_ms);
+}
+
+void TimeManager::ponderhit()
+{
+  start_ticks.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+  pondering.store(false, std::memory_order_relaxed);
+}
+
+double TimeManager::elapsedMs() const
+{
+  Clock::duration ticks(start_ticks.load(std::memory_order_relaxed));
+  std::chrono::duration<double, std::milli> elapsed = Clock::now() - Clock::time_point(ticks);
+  return elapsed.count();
+}
+
+void TimeManager::iterationDone(bool best_move_changed)
+{
+  stable_iterations = best_move_changed ? 0 : std::min(stable_iterations + 1, max_stability);
+  soft_scale = stability_scale[stable_iterations];
+}
+
+bool TimeManager::softExpired() const
+{
+  if (!limited || pondering.load(std::memory_order_relaxed))
+    return false;
+  return elapsedMs() >= std::min(soft_ms * soft_scale, hard_ms);
+}
+
+bool TimeManager::hardExpired() const
+{
+  if (!limited || pondering.load(std::memory_order_relaxed))
+    return false;
+  return elapsedMs() >= hard_ms;
+}
+
+double TimeManager::softLimitMs() const
+{
+  return std::min(soft_ms * soft_scale, hard_ms);
+}
+
+double TimeManager::hardLimitMs() const
+{
+  return hard_ms;
+}
+
+} // namespace Wyvern
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "types.h"
+#include <atomic>
+#include <chrono>
+
+namespace Wyvern
+{
+
+// a clock that the go command did not give
+constexpr int no_clock = INT32_MIN;
+
+// the limits of one search, as given to a uci go command. times are in
+// milliseconds, 0 where not given but for the clocks, which may run out
+struct GoLimits
+{
+  int wtime = no_clock;
+  int btime = no_clock;
+  int winc = 0;
+  int binc = 0;
+  int movestogo = 0;
+  int movetime = 0;
+  int depth = 0;
+  U64 nodes = 0;
+  bool infinite = false;
+  bool ponder = false;
+};
+
+// left on the clock for the gui and the pipe
+constexpr int move_overhead_ms = 30;
+// moves the clock is shared over when the gui does not say
+constexpr int default_moves_to_go = 30;
+// all a search gets once the clock has run out
+constexpr int out_of_time_ms = 1;
+
+// when a search should stop, on a steady clock. past the soft limit no new
+// iteration is started; past the hard limit the search is stopped where it
+// is. the soft limit is scaled by how settled the best move is, shrinking
+// while iterations agree and growing when they change their mind.
+class TimeManager
+{
+private:
+  using Clock = std::chrono::steady_clock;
+  // start of the clock, as ticks so that ponderhit can restart it while the
+  // search is reading it
+  std::atomic<Clock::rep> start_ticks{0};
+  std::atomic<bool> pondering{false};
+  bool limited = false;
+  double soft_ms = 0;
+  double hard_ms = 0;
+  double soft_scale = 1.0;
+  int stable_iterations = 0;
+
+public:
+  // starts the clock for side to move under limits. a pondering search has
+  // no limits until ponderhit
+  void start(const GoLimits& limits, enum Color side);
+  void ponderhit();
+  // milliseconds since the clock started
+  double elapsedMs() const;
+  // after each iteration, whether its best move differs from the last one's
+  void iterationDone(bool best_move_changed);
+  bool softExpired() const;
+  bool hardExpired() const;
+  double softLimitMs() const;
+  double hardLimitMs() const;
+};
+
+} // namespace Wyvern
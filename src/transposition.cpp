@@ -1,19 +1,267 @@
 #include "transposition.h"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
 namespace Wyvern
 {
 
-TranspositionTable::TranspositionTable(int b) : bits(b), table(1ULL << bits) {}
+// data word layout:
+//  bits  0-15 eval (mate scores folded into the top of the 16 bit range)
+//  bits 16-23 depth
+//  bits 24-25 bound
+//  bits 26-31 generation
+//  bits 32-54 best move
+//  bit     55 valid flag
+constexpr U64 entry_valid = 1ULL << 55;
+constexpr int packed_mate = 32767;
+constexpr int packed_mate_range = 1000;
+constexpr int packed_eval_limit = packed_mate - packed_mate_range - 1;
+
+static U16 packEval(int eval)
+{
+  int packed = eval;
+  if (eval >= INT32_MAX - packed_mate_range)
+    packed = packed_mate - (INT32_MAX - eval);
+  else if (eval <= packed_mate_range - INT32_MAX)
+    packed = -packed_mate + (INT32_MAX + eval);
+  else if (eval > packed_eval_limit)
+    packed = packed_eval_limit;
+  else if (eval < -packed_eval_limit)
+    packed = -packed_eval_limit;
+  return static_cast<U16>(static_cast<int16_t>(packed));
+}
+
+static int unpackEval(U16 bits)
+{
+  int packed = static_cast<int16_t>(bits);
+  if (packed > packed_eval_limit)
+    return INT32_MAX - (packed_mate - packed);
+  if (packed < -packed_eval_limit)
+    return -INT32_MAX + (packed_mate + packed);
+  return packed;
+}
+
+static U32 unpackMove(U64 data)
+{
+  return static_cast<U32>((data >> 32) & 0x7FFFFF);
+}
+
+static U64 loadData(const U64& data)
+{
+  return std::atomic_ref<U64>(const_cast<U64&>(data)).load(std::memory_order_relaxed);
+}
+
+static void storeEntry(U64& key_xor_data, U64& data, U64 key, U64 new_data)
+{
+  std::atomic_ref<U64>(data).store(new_data, std::memory_order_relaxed);
+  std::atomic_ref<U64>(key_xor_data).store(key ^ new_data, std::memory_order_relaxed);
+}
+
+TranspositionTable::TranspositionTable()
+    : table(nullptr), bucket_count(0), alloc_bytes(0), alloc_align(0), huge_pages(false),
+      generation(0), requested_mb(default_mb)
+{
+}
+
+TranspositionTable::TranspositionTable(int b)
+    : table(nullptr), bucket_count(0), alloc_bytes(0), alloc_align(0), huge_pages(false),
+      generation(0), requested_mb(0)
+{
+  allocate(b > 2 ? 1ULL << (b - 2) : 1ULL, false);
+  clear();
+}
 
-BoundedEval TranspositionTable::lookup(U64 key, int depth)
+TranspositionTable::~TranspositionTable()
 {
-  const auto mask = static_cast<U64>(table.size() - 1);
-  const Entry& tgt_deep = table[(key & mask) & ~1ULL];
-  const Entry& tgt_shallow = table[(key & mask) | 1ULL];
-  if (tgt_shallow.zobrist_key == key && depth <= tgt_shallow.depth)
-    return tgt_shallow.value;
-  if (tgt_deep.zobrist_key == key && depth <= tgt_deep.depth)
-    return tgt_deep.value;
+  release();
+}
+
+TranspositionTable::TranspositionTable(TranspositionTable&& tt) noexcept
+    : table(std::exchange(tt.table, nullptr)), bucket_count(std::exchange(tt.bucket_count, 0)),
+      alloc_bytes(std::exchange(tt.alloc_bytes, 0)), alloc_align(std::exchange(tt.alloc_align, 0)),
+      huge_pages(tt.huge_pages), generation(tt.generation), requested_mb(tt.requested_mb)
+{
+}
+
+TranspositionTable& TranspositionTable::operator=(TranspositionTable&& tt) noexcept
+{
+  if (this != &tt)
+  {
+    release();
+    table = std::exchange(tt.table, nullptr);
+    bucket_count = std::exchange(tt.bucket_count, 0);
+    alloc_bytes = std::exchange(tt.alloc_bytes, 0);
+    alloc_align = std::exchange(tt.alloc_align, 0);
+    huge_pages = tt.huge_pages;
+    generation = tt.generation;
+    requested_mb = tt.requested_mb;
+  }
+  return *this;
+}
+
+void TranspositionTable::allocate(size_t buckets, bool use_huge_pages)
+{
+  release();
+  size_t bytes = buckets * sizeof(Bucket);
+  size_t align = alignof(Bucket);
+#ifdef __linux__
+  if (use_huge_pages && bytes >= huge_page_size)
+  {
+    align = huge_page_size;
+    bytes = (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+  }
+  else
+    use_huge_pages = false;
+#else
+  use_huge_pages = false;
+#endif
+  table = static_cast<Bucket*>(::operator new(bytes, std::align_val_t(align)));
+#ifdef __linux__
+  if (use_huge_pages)
+    madvise(table, bytes, MADV_HUGEPAGE);
+#endif
+  bucket_count = buckets;
+  alloc_bytes = bytes;
+  alloc_align = align;
+  huge_pages = use_huge_pages;
+}
+
+void TranspositionTable::release()
+{
+  if (table)
+    ::operator delete(table, std::align_val_t(alloc_align));
+  table = nullptr;
+  bucket_count = 0;
+  alloc_bytes = 0;
+}
+
+void TranspositionTable::resize(size_t mb, bool use_huge_pages, int threads)
+{
+  size_t buckets = std::bit_floor(std::max<size_t>(mb * 1024 * 1024 / sizeof(Bucket), 1));
+  allocate(buckets, use_huge_pages);
+  clear(threads);
+  requested_mb = mb;
+}
+
+bool TranspositionTable::ensureAllocated(int threads)
+{
+  if (table)
+    return false;
+  resize(requested_mb, true, threads);
+  return true;
+}
+
+void TranspositionTable::clear(int threads)
+{
+  threads = std::max(threads, 1);
+  size_t chunk = (bucket_count + threads - 1) / threads;
+  auto clear_range = [this, chunk](int t)
+  {
+    size_t begin = std::min(bucket_count, chunk * t);
+    size_t end = std::min(bucket_count, begin + chunk);
+    std::memset(static_cast<void*>(table + begin), 0, (end - begin) * sizeof(Bucket));
+  };
+  std::vector<std::thread> workers;
+  for (int t = 1; t < threads; t++)
+    workers.emplace_back(clear_range, t);
+  clear_range(0);
+  for (auto& w : workers)
+    w.join();
+}
+
+size_t TranspositionTable::sizeMB() const
+{
+  return bucket_count * sizeof(Bucket) / (1024 * 1024);
+}
+
+bool TranspositionTable::usesHugePages() const
+{
+  return huge_pages;
+}
+
+void TranspositionTable::newSearch()
+{
+  generation = (generation + 1) & 63;
+}
+
+int TranspositionTable::hashfull() const
+{
+  size_t samples = std::min<size_t>(bucket_count, 250);
+  int used = 0;
+  for (size_t i = 0; i < samples; i++)
+  {
+    for (const Entry& e : table[i].entries)
+    {
+      U64 data = loadData(e.data);
+      if (unpackDepth(data) >= 0 && unpackGeneration(data) == generation)
+        used++;
+    }
+  }
+  return samples ? static_cast<int>(used * 1000 / (samples * bucket_entries)) : 0;
+}
+
+U64 TranspositionTable::pack(BoundedEval value, int depth, U32 move, int gen)
+{
+  U64 d = (depth < 0) ? 0 : (depth > 255) ? 255 : depth;
+  return static_cast<U64>(packEval(value.eval)) | (d << 16) |
+         (static_cast<U64>(value.bound & 3) << 24) | (static_cast<U64>(gen & 63) << 26) |
+         (static_cast<U64>(move & 0x7FFFFF) << 32) | entry_valid;
+}
+
+BoundedEval TranspositionTable::unpackValue(U64 data)
+{
+  int bound = static_cast<int>((data >> 24) & 3);
+  if (bound == 3)
+    bound = BOUND_LOWER;
+  return BoundedEval(static_cast<enum Bound>(bound), unpackEval(static_cast<U16>(data)));
+}
+
+int TranspositionTable::unpackDepth(U64 data)
+{
+  if (!(data & entry_valid))
+    return -1;
+  return static_cast<int>((data >> 16) & 0xFF);
+}
+
+int TranspositionTable::unpackGeneration(U64 data)
+{
+  return static_cast<int>((data >> 26) & 63);
+}
+
+BoundedEval TranspositionTable::lookup(U64 key, int depth, U32* hash_move)
+{
+  if (!table)
+    return BoundedEval(BOUND_INVALID, 0);
+  Bucket& bucket = table[key & (bucket_count - 1)];
+  for (Entry& e : bucket.entries)
+  {
+    U64 data = loadData(e.data);
+    if ((loadData(e.key_xor_data) ^ data) == key)
+    {
+      if (hash_move)
+        *hash_move = unpackMove(data);
+      // refresh the generation so that entries still in use are not aged out
+      if (unpackGeneration(data) != generation)
+      {
+        U64 refreshed = (data & ~(63ULL << 26)) | (static_cast<U64>(generation) << 26);
+        storeEntry(e.key_xor_data, e.data, key, refreshed);
+      }
+      if (depth <= unpackDepth(data))
+        return unpackValue(data);
+      break;
+    }
+  }
   return BoundedEval(BOUND_INVALID, 0);
 }
 
@@ -31,21 +279,51 @@ BoundedEval strongerBound(BoundedEval v1, BoundedEval v2)
     return (v1.eval >= v2.eval) ? v1 : v2;
 }
 
-void TranspositionTable::insert(U64 key, BoundedEval value, int depth)
+// replacement policy: an entry for the same key is overwritten unless it holds
+// a deeper result from the current search (exact results may still replace a
+// deeper bound). otherwise the least valuable entry in the bucket goes, where
+// value is depth, less 8 plies per generation of age, plus a bonus for exact
+// bounds.
+void TranspositionTable::insert(U64 key, BoundedEval value, int depth, U32 move)
 {
-  const auto mask = static_cast<U64>(table.size() - 1);
-  Entry& tgt_deep = table[(key & mask) & ~1ULL];
-  Entry& tgt_shallow = table[(key & mask) | 1ULL];
-  if (tgt_deep.zobrist_key == key)
+  if (!table)
+    return;
+  Bucket& bucket = table[key & (bucket_count - 1)];
+  Entry* replace = &bucket.entries[0];
+  int replace_worth = INT32_MAX;
+  for (Entry& e : bucket.entries)
   {
-    if (tgt_deep.depth < depth)
-      tgt_deep.value = value;
-    if (tgt_deep.depth == depth)
+    U64 data = loadData(e.data);
+    int e_depth = unpackDepth(data);
+    int e_age = (generation - unpackGeneration(data)) & 63;
+    BoundedEval e_value = unpackValue(data);
+    if ((loadData(e.key_xor_data) ^ data) == key)
+    {
+      bool exact_over_bound = value.bound == BOUND_EXACT && e_value.bound != BOUND_EXACT;
+      if (e_depth > depth && e_age == 0 && !exact_over_bound)
+        return;
+      if (e_depth == depth)
+        value = strongerBound(e_value, value);
+      if (move == MOVE_NONE)
+        move = unpackMove(data);
+      replace = &e;
+      break;
+    }
+    if (e_depth < 0)
+    {
+      if (replace_worth != INT32_MIN)
+        replace = &e;
+      replace_worth = INT32_MIN;
+      continue;
+    }
+    int worth = e_depth - 8 * e_age + ((e_value.bound == BOUND_EXACT) ? 2 : 0);
+    if (worth < replace_worth)
     {
-      tgt_deep.value = strongerBound(tgt_deep.value, value);
+      replace = &e;
+      replace_worth = worth;
     }
   }
-  tgt_shallow = Entry(key, value, depth);
+  storeEntry(replace->key_xor_data, replace->data, key, pack(value, depth, move, generation));
 }
 
 } // namespace Wyvern
@@ -1,40 +1,87 @@
 #pragma once
 
 #include <cstddef>
-#include <vector>
 
 #include "types.h"
 
 namespace Wyvern
 {
 
+// the table is split into 64 byte buckets of four entries, so a probe costs a
+// single cache miss. each entry packs the eval, depth, bound, generation and
+// best move into one data word, and stores the key xor'd with that word.
+// entries are read and written with relaxed atomics so that several search
+// threads can share one table without locking: a torn write (key from one
+// store, data from another) fails the key check and reads as a miss.
+//
+// the table lives in one aligned block that is resized at runtime. on linux
+// the block is aligned to 2MB and madvise'd for transparent huge pages, which
+// cuts tlb misses on probes; clearing is split across threads so that large
+// tables can be (re)initialised between searches quickly. a default
+// constructed table allocates nothing until ensureAllocated or resize; until
+// then every lookup misses and inserts are dropped.
 class TranspositionTable
 {
 private:
-  static constexpr int default_bits = 23; // ~200MB
+  static constexpr int bucket_entries = 4;
+  static constexpr size_t huge_page_size = 2 * 1024 * 1024;
 
   struct Entry
   {
-    U64 zobrist_key = 0;
-    BoundedEval value = BoundedEval(BOUND_INVALID, 0);
-    int depth = -1;
+    U64 key_xor_data = 0;
+    U64 data = 0;
+  };
 
-    Entry() = default;
-    Entry(U64 zk, BoundedEval v, int d) : zobrist_key(zk), value(v), depth(d) {}
+  struct alignas(64) Bucket
+  {
+    Entry entries[bucket_entries];
   };
 
-  int bits;
-  std::vector<Entry> table;
+  static U64 pack(BoundedEval value, int depth, U32 move, int gen);
+  static BoundedEval unpackValue(U64 data);
+  static int unpackDepth(U64 data);
+  static int unpackGeneration(U64 data);
+
+  Bucket* table;
+  size_t bucket_count;
+  size_t alloc_bytes;
+  size_t alloc_align;
+  bool huge_pages;
+  int generation;
+  size_t requested_mb;
+  void allocate(size_t buckets, bool use_huge_pages);
+  void release();
 
 public:
-  BoundedEval lookup(U64 key, int depth);
-  void insert(U64 key, BoundedEval value, int depth);
+  // size allocated by a default constructed table
+  static constexpr size_t default_mb = 128;
+
+  // if hash_move is given it receives the stored best move for the key, even
+  // when the entry is too shallow for its eval to be used
+  BoundedEval lookup(U64 key, int depth, U32* hash_move = nullptr);
+  void insert(U64 key, BoundedEval value, int depth, U32 move = MOVE_NONE);
+
+  // resizes to the largest power of two number of buckets that fits in mb
+  // megabytes, and clears it. must not be called while a search is running.
+  void resize(size_t mb, bool use_huge_pages = true, int threads = 1);
+  void clear(int threads = 1);
+  // allocates (and clears) the table at the last requested size if that has
+  // not happened yet; returns whether it did
+  bool ensureAllocated(int threads = 1);
+  size_t sizeMB() const;
+  // starts a new search generation; entries from older generations are
+  // preferred for replacement
+  void newSearch();
+  // permille of sampled entries written in the current generation
+  int hashfull() const;
+  bool usesHugePages() const;
 
-  TranspositionTable() : TranspositionTable(default_bits) {}
+  TranspositionTable();
+  // b is log2 of the number of entries
   explicit TranspositionTable(int b);
-  ~TranspositionTable() = default;
-  TranspositionTable(TranspositionTable&& tt) noexcept = default;
-  TranspositionTable& operator=(TranspositionTable&&) noexcept = default;
+  ~TranspositionTable();
+  TranspositionTable(TranspositionTable&& tt) noexcept;
+  TranspositionTable& operator=(TranspositionTable&&) noexcept;
   TranspositionTable& operator=(TranspositionTable const& tt) = delete;
   TranspositionTable(TranspositionTable const& tt) = delete;
 };
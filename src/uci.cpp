@@ -0,0 +1,272 @@
+#include "uci.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace Wyvern
+{
+
+namespace
+{
+
+void send(const std::string& line)
+{
+  std::cout << line + "\n" << std::flush;
+}
+
+} // namespace
+
+GoLimits parseGoLimits(std::istringstream& args)
+{
+  GoLimits limits;
+  std::string token;
+  while (args >> token)
+  {
+    if (token == "wtime")
+      args >> limits.wtime;
+    else if (token == "btime")
+      args >> limits.btime;
+    else if (token == "winc")
+      args >> limits.winc;
+    else if (token == "binc")
+      args >> limits.binc;
+    else if (token == "movestogo")
+      args >> limits.movestogo;
+    else if (token == "movetime")
+      args >> limits.movetime;
+    else if (token == "depth")
+      args >> limits.depth;
+    else if (token == "nodes")
+      args >> limits.nodes;
+    else if (token == "infinite")
+      limits.infinite = true;
+    else if (token == "ponder")
+      limits.ponder = true;
+  }
+  return limits;
+}
+
+U32 parseUciMove(MoveGenerator& movegen, Position& pos, std::string_view text)
+{
+  MoveList moves;
+  if (pos.getToMove() == COLOR_WHITE)
+    movegen.generateMoves<COLOR_WHITE>(pos, true, moves);
+  else
+    movegen.generateMoves<COLOR_BLACK>(pos, true, moves);
+  for (U32 move : moves)
+  {
+    if (moveString(move) == text)
+      return move;
+  }
+  return MOVE_NONE;
+}
+
+Uci::Uci() : movegen(MagicTable::shared())
+{
+  search.setUciOutput(true);
+}
+
+Uci::~Uci()
+{
+  stopSearch();
+}
+
+void Uci::loop(std::istream& in)
+{
+  std::string line;
+  while (std::getline(in, line))
+  {
+    if (!command(line))
+      return;
+  }
+  // at the end of the input a search with limits runs to its bestmove
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return !searching || pondering; });
+  }
+  stopSearch();
+}
+
+bool Uci::command(const std::string& line)
+{
+  std::istringstream args(line);
+  std::string token;
+  args >> token;
+  if (token == "uci")
+  {
+    send("id name WyvernChess");
+    send("id author master-spike");
+    const std::string hash_mb = std::to_string(TranspositionTable::default_mb);
+    send("option name Hash type spin default " + hash_mb + " min 1 max 65536");
+    send("option name Threads type spin default 1 min 1 max 256");
+    send("option name Ponder type check default false");
+    send("option name EvalFile type string default <empty>");
+    send("option name Clear Hash type button");
+    send("uciok");
+  }
+  else if (token == "isready")
+    send("readyok");
+  else if (token == "ucinewgame")
+  {
+    stopSearch();
+    search.clearHash();
+    position = Position();
+  }
+  else if (token == "position")
+  {
+    stopSearch();
+    setPosition(args);
+  }
+  else if (token == "setoption")
+  {
+    stopSearch();
+    setOption(args);
+  }
+  else if (token == "go")
+    go(args);
+  else if (token == "stop")
+    stopSearch();
+  else if (token == "ponderhit")
+    ponderhit();
+  else if (token == "quit")
+  {
+    stopSearch();
+    return false;
+  }
+  return true;
+}
+
+void Uci::setPosition(std::istringstream& args)
+{
+  std::string token;
+  args >> token;
+  if (token == "startpos")
+  {
+    position = Position();
+    args >> token;
+  }
+  else if (token == "fen")
+  {
+    std::string fen;
+    while (args >> token && token != "moves")
+      fen += token + " ";
+    position = Position(fen.c_str());
+  }
+  if (token != "moves")
+    return;
+  while (args >> token)
+  {
+    U32 move = parseUciMove(movegen, position, token);
+    if (move == MOVE_NONE)
+    {
+      send("info string illegal move " + token);
+      return;
+    }
+    position.makeMove(move);
+  }
+}
+
+void Uci::setOption(std::istringstream& args)
+{
+  std::string token, name, value;
+  args >> token; // name
+  while (args >> token && token != "value")
+    name += (name.empty() ? "" : " ") + token;
+  std::getline(args >> std::ws, value);
+  if (name == "Hash")
+    search.setHashSize(std::max(std::atoi(value.c_str()), 1));
+  else if (name == "Threads")
+    search.setThreads(std::atoi(value.c_str()));
+  else if (name == "Clear Hash")
+    search.clearHash();
+  else if (name == "EvalFile")
+  {
+    if (value.empty() || value == "<empty>")
+      search.setNetwork(nullptr);
+    else if (!search.loadNetwork(value))
+      send("info string cannot load " + value);
+  }
+}
+
+void Uci::go(std::istringstream& args)
+{
+  stopSearch();
+  GoLimits limits = parseGoLimits(args);
+  search.startClock(limits, position.getToMove());
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    searching = true;
+    pondering = limits.ponder || limits.infinite;
+    stop_requested = false;
+  }
+  worker = std::thread(&Uci::runSearch, this, position, limits);
+  stopper = std::thread(&Uci::runStopper, this);
+}
+
+// the clock starts now for a search that was pondering
+void Uci::ponderhit()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!searching)
+    return;
+  search.ponderhit();
+  pondering = false;
+  changed.notify_all();
+}
+
+void Uci::stopSearch()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop_requested = true;
+    changed.notify_all();
+  }
+  if (worker.joinable())
+    worker.join();
+  if (stopper.joinable())
+    stopper.join();
+}
+
+void Uci::runSearch(Position pos, GoLimits limits)
+{
+  int eval = 0;
+  U32 move = search.bestmove(pos, limits, eval);
+  std::vector<U32> pv = search.principalVariation(pos, move, 2);
+  {
+    // no bestmove while pondering or searching infinitely, even if the
+    // search has run out of depth
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return !pondering || stop_requested; });
+    searching = false;
+    changed.notify_all();
+  }
+  if (move == MOVE_NONE)
+  {
+    send("bestmove 0000");
+    return;
+  }
+  std::string line = "bestmove " + moveString(move);
+  if (pv.size() > 1)
+    line += " ponder " + moveString(pv[1]);
+  send(line);
+}
+
+// a stop can land before bestmove has started and cleared the flag, so it is
+// sent again every millisecond until the worker is done
+void Uci::runStopper()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (searching)
+  {
+    if (stop_requested)
+    {
+      search.stop();
+      changed.wait_for(lock, std::chrono::milliseconds(1));
+    }
+    else
+      changed.wait(lock);
+  }
+}
+
+} // namespace Wyvern
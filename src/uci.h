@@ -0,0 +1,62 @@
+#pragma once
+
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+#include "timeman.h"
+#include "types.h"
+#include <condition_variable>
+#include <istream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace Wyvern
+{
+
+GoLimits parseGoLimits(std::istringstream& args);
+// the legal move written as text in uci's long algebraic form (e2e4, e7e8q),
+// or MOVE_NONE if there is none
+U32 parseUciMove(MoveGenerator& movegen, Position& pos, std::string_view text);
+
+// the uci protocol. a go starts the search on a worker thread, so that stop,
+// ponderhit and isready are answered while it runs. the search keeps its own
+// time; a stopper thread stops it at once on stop.
+class Uci
+{
+private:
+  Search search;
+  MoveGenerator movegen;
+  Position position;
+  std::thread worker;
+  std::thread stopper;
+  // guards everything below, shared by the reading, worker and stopper threads
+  std::mutex mutex;
+  std::condition_variable changed;
+  bool searching = false;
+  // go ponder and go infinite hold bestmove back until ponderhit or stop
+  bool pondering = false;
+  bool stop_requested = false;
+
+  void setPosition(std::istringstream& args);
+  void setOption(std::istringstream& args);
+  void go(std::istringstream& args);
+  void ponderhit();
+  // stops any search and waits for its bestmove
+  void stopSearch();
+  void runSearch(Position pos, GoLimits limits);
+  void runStopper();
+
+public:
+  Uci();
+  ~Uci();
+  Uci(const Uci&) = delete;
+  // reads commands until quit or the end of the input
+  void loop(std::istream& in);
+  // false after quit
+  bool command(const std::string& line);
+};
+
+} // namespace Wyvern
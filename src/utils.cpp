@@ -13,6 +13,14 @@ U64 rand64()
   return u0 + (u1 << 16) + (u2 << 32) + (u3 << 48);
 }
 
+U64 xorshift64star(U64& state)
+{
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return state * 0x2545F4914F6CDD1DULL;
+}
+
 void seedRand()
 {
   std::srand(std::time(nullptr));
@@ -32,3 +40,16 @@ void printSq(int p)
 {
   std::cout << (char)('a' + (p & 7)) << (char)('1' + ((p >> 3) & 7));
 }
+
+std::string moveString(U32 move)
+{
+  std::string out;
+  for (int p : {(int)(move & 63), (int)((move >> 6) & 63)})
+  {
+    out += (char)('a' + (p & 7));
+    out += (char)('1' + ((p >> 3) & 7));
+  }
+  if ((move & Wyvern::MOVE_SPECIAL) == Wyvern::PROMO)
+    out += "nbrq"[(move >> 12) & 3];
+  return out;
+}
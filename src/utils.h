@@ -2,10 +2,18 @@
 
 #include "types.h"
 
+#include <string>
+
 U64 rand64();
 
+// xorshift64*; state must not be zero
+U64 xorshift64star(U64& state);
+
 void seedRand();
 
 void printbb(U64 bb);
 
 void printSq(int p);
+
+// long algebraic notation, e.g. e2e4 or e7e8q
+std::string moveString(U32 move);
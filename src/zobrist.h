@@ -281,7 +281,7 @@ inline U64 zobristCR(enum CastlingRights cr)
   U64 ret = 0;
   while (cri)
   {
-    ret ^= zobrist_castling_rights[std::countr_zero(static_cast<U32>(cr))];
+    ret ^= zobrist_castling_rights[std::countr_zero(cri)];
     cri &= cri - 1;
   }
   return ret;
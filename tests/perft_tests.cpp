@@ -1,32 +1,39 @@
+#include "evalcache.h"
+#include "nnue.h"
 #include "position.h"
 #include "search.h"
+#include "simd.h"
+#include "timeman.h"
 #include "transposition.h"
+#include "uci.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <span>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <vector>
 
 namespace
 {
 
 constexpr char kiwipete_fen[] = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R";
 
-struct PerftResult
-{
-  U64 nodes;
-  int captures;
-  int en_passant;
-  int castles;
-  int promotions;
-  int checks;
-};
-
-PerftResult run_perft(Wyvern::Search& search, Wyvern::Position& position, int depth)
+using PerftResult = Wyvern::PerftCounters;
+
+PerftResult run_perft(Wyvern::Search& search, Wyvern::Position& position, int depth,
+                      int threads = 1, size_t hash_mb = 0)
 {
-  PerftResult result{0, 0, 0, 0, 0, 0};
-  result.nodes = search.perft(position, depth, &result.captures, &result.en_passant,
-                              &result.promotions, &result.castles, &result.checks);
-  return result;
+  Wyvern::PerftOptions options;
+  options.threads = threads;
+  options.hash_mb = hash_mb;
+  options.validate = true;
+  return search.perft(position, depth, options);
 }
 
 bool expect_eq(std::string_view name, U64 actual, U64 expected)
@@ -52,6 +59,135 @@ bool expect_bound(std::string_view name, Wyvern::Bound actual, Wyvern::Bound exp
   return false;
 }
 
+// pawn key, material and piece-square sums recomputed from the bitboards
+bool scores_consistent(const Wyvern::Position& position)
+{
+  Wyvern::PsqtScores expected{};
+  for (int i = 0; i < Wyvern::KING; i++)
+  {
+    for (int color = 0; color < 2; color++)
+    {
+      for (U64 ps = position.getPieces()[i] & position.getPieceColors()[color]; ps; ps &= ps - 1)
+      {
+        int p = Wyvern::psqtSquare(color, std::countr_zero(ps));
+        expected.middle_game[color] += Wyvern::psqt_middle_game[i][p];
+        expected.end_game[color] += Wyvern::psqt_end_game[i][p];
+        expected.material[color] += (i == Wyvern::KING - 1) ? 0 : Wyvern::pvals[i];
+        expected.phase += Wyvern::phase_values[i];
+      }
+    }
+  }
+  U64 pawn_key = 0;
+  for (int color = 0; color < 2; color++)
+  {
+    U64 pawns = position.getPieces()[Wyvern::PAWN - 1] & position.getPieceColors()[color];
+    for (; pawns; pawns &= pawns - 1)
+      pawn_key ^= Wyvern::zobristNum(Wyvern::PAWN - 1, color, std::countr_zero(pawns));
+  }
+  if (position.getPawnKey() != pawn_key)
+    return false;
+  const Wyvern::PsqtScores& actual = position.getScores();
+  return actual.middle_game == expected.middle_game && actual.end_game == expected.end_game &&
+         actual.material == expected.material && actual.phase == expected.phase;
+}
+
+// walks every line to depth, calling check on each node after the make and
+// again after the unmake; false as soon as one check fails
+template <typename F>
+bool walk(Wyvern::MoveGenerator& movegen, Wyvern::Position& position, int depth, F&& check)
+{
+  if (!check(position))
+    return false;
+  if (depth == 0)
+    return true;
+  Wyvern::MoveList moves;
+  if (position.getToMove() == Wyvern::COLOR_WHITE)
+    movegen.generateMoves<Wyvern::COLOR_WHITE>(position, true, moves);
+  else
+    movegen.generateMoves<Wyvern::COLOR_BLACK>(position, true, moves);
+  for (U32 move : moves)
+  {
+    position.makeMove(move);
+    bool ok = walk(movegen, position, depth - 1, check);
+    position.unmakeMove();
+    if (!ok || !check(position))
+      return false;
+  }
+  return true;
+}
+
+// the mailbox board, the pawn key and the psqt scores agree with the bitboards
+bool board_consistent(const Wyvern::Position& position)
+{
+  if (!scores_consistent(position))
+    return false;
+  const U64* pieces = position.getPieces();
+  for (int sq = 0; sq < 64; sq++)
+  {
+    U8 expected = Wyvern::PIECE_NONE;
+    for (int i = 0; i < Wyvern::KING; i++)
+    {
+      if (pieces[i] & (1ULL << sq))
+        expected = i + 1;
+    }
+    if (position.getBoard()[sq] != expected)
+      return false;
+  }
+  return true;
+}
+
+// a network file with small random weights, so that accumulators cannot overflow
+std::vector<int16_t> random_network_file()
+{
+  std::vector<int16_t> words(Wyvern::NnueNetwork::file_size / sizeof(int16_t));
+  U64 state = 0x2545F4914F6CDD1DULL;
+  for (int16_t& w : words)
+    w = static_cast<int16_t>(xorshift64star(state) % 64) - 32;
+  return words;
+}
+
+// the network's evaluation straight from the file's weights
+int reference_nnue_eval(const std::vector<int16_t>& words, const Wyvern::Position& position)
+{
+  const int16_t* feature_weights = words.data();
+  const int16_t* feature_bias = feature_weights + Wyvern::nnue_inputs * Wyvern::nnue_hidden;
+  const int16_t* output_weights = feature_bias + Wyvern::nnue_hidden;
+  const int16_t output_bias = output_weights[2 * Wyvern::nnue_hidden];
+  int stm = position.getToMove();
+  long long sum = output_bias;
+  for (int side = 0; side < 2; side++)
+  {
+    int perspective = side ? stm ^ 1 : stm;
+    for (int i = 0; i < Wyvern::nnue_hidden; i++)
+    {
+      int acc = feature_bias[i];
+      for (int pt = 0; pt < 6; pt++)
+      {
+        for (int color = 0; color < 2; color++)
+        {
+          U64 ps = position.getPieces()[pt] & position.getPieceColors()[color];
+          for (; ps; ps &= ps - 1)
+          {
+            int sq = std::countr_zero(ps) ^ (perspective ? 56 : 0);
+            int feature = (color != perspective) * 384 + pt * 64 + sq;
+            acc += feature_weights[feature * Wyvern::nnue_hidden + i];
+          }
+        }
+      }
+      sum += std::clamp(acc, 0, Wyvern::nnue_qa) * output_weights[side * Wyvern::nnue_hidden + i];
+    }
+  }
+  return static_cast<int>(sum * Wyvern::nnue_scale / (Wyvern::nnue_qa * Wyvern::nnue_qb));
+}
+
+// the incrementally updated accumulator matches a refresh
+bool nnue_consistent(const Wyvern::NnueNetwork& network, const Wyvern::Position& position)
+{
+  Wyvern::NnueAccumulator fresh;
+  network.refresh(fresh, position.getPieces(), position.getPieceColors());
+  return fresh.values == position.getAccumulator().values;
+}
+
 bool expect_perft(std::string_view name, const PerftResult& actual, const PerftResult& expected)
 {
   bool ok = true;
@@ -99,6 +235,358 @@ int main()
       expect_perft("kiwipete.depth2", run_perft(search, position, 2), {2039, 351, 1, 91, 0, 3}) &&
       ok;
   }
+  {
+    // full fens: black to move with only some castling rights, and no castling
+    Wyvern::Position mirrored("r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1");
+    ok = expect_eq("fen.position4_mirrored.depth3", run_perft(search, mirrored, 3).nodes, 9467) &&
+         ok;
+    Wyvern::Position position3("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1");
+    ok = expect_eq("fen.position3.depth3", run_perft(search, position3, 3).nodes, 2812) && ok;
+  }
+  {
+    Wyvern::MoveGenerator movegen(Wyvern::MagicTable::shared());
+    Wyvern::Position played;
+    played.makeMove(Wyvern::parseUciMove(movegen, played, "e2e4"));
+    Wyvern::Position parsed("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1");
+    ok = expect_eq("fen.to_move", parsed.getToMove(), Wyvern::COLOR_BLACK) && ok;
+    ok = expect_eq("fen.castling", parsed.getCR(), Wyvern::CR_ANY) && ok;
+    ok = expect_eq("fen.ep_square", parsed.getEpSquare(), 1ULL << 20) && ok;
+    ok = expect_eq("fen.zobrist", parsed.getZobrist(), played.getZobrist()) && ok;
+    // a null move only passes the turn and clears the en passant square
+    played.makeMove(Wyvern::MOVE_NULL);
+    Wyvern::Position passed("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 1");
+    ok = expect_eq("null_move.to_move", played.getToMove(), Wyvern::COLOR_WHITE) && ok;
+    ok = expect_eq("null_move.ep_square", played.getEpSquare(), 0) && ok;
+    ok = expect_eq("null_move.zobrist", played.getZobrist(), passed.getZobrist()) && ok;
+    ok = expect_eq("null_move.depth2", run_perft(search, played, 2).nodes,
+                   run_perft(search, passed, 2).nodes) &&
+         ok;
+    played.unmakeMove();
+    ok = expect_eq("null_move.unmake.zobrist", played.getZobrist(), parsed.getZobrist()) && ok;
+    ok = expect_eq("null_move.unmake.ep_square", played.getEpSquare(), 1ULL << 20) && ok;
+    Wyvern::Position counters("4k3/8/8/8/8/8/8/4K3 w - - 37 80");
+    ok = expect_eq("fen.no_castling", counters.getCR(), Wyvern::CR_NONE) && ok;
+    ok = expect_eq("fen.hmc", counters.getHMC(), 37) && ok;
+    ok = expect_eq("fen.fmc", counters.getFMC(), 80) && ok;
+    // a pass still counts towards the fifty move rule
+    counters.makeMove(Wyvern::MOVE_NULL);
+    ok = expect_eq("null_move.hmc", counters.getHMC(), 38) && ok;
+    counters.unmakeMove();
+    ok = expect_eq("null_move.unmake.hmc", counters.getHMC(), 37) && ok;
+  }
+  {
+    Wyvern::Position position(kiwipete_fen);
+    ok = expect_perft("kiwipete.depth3.threads", run_perft(search, position, 3, 3),
+                      {97862, 17102, 45, 3162, 0, 993}) &&
+         ok;
+  }
+  {
+    Wyvern::Position position(kiwipete_fen);
+    ok = expect_perft("kiwipete.depth3.hash", run_perft(search, position, 3, 2, 1),
+                      {97862, 17102, 45, 3162, 0, 993}) &&
+         ok;
+  }
+  {
+    // transpositions from the start position must hit the perft table
+    Wyvern::Position position;
+    ok = expect_perft("startpos.depth4.hash", run_perft(search, position, 4, 1, 1),
+                      {197281, 1576, 0, 0, 0, 469}) &&
+         ok;
+  }
+  {
+    Wyvern::Position position;
+    const U64 start_key = position.getZobrist();
+    position.makeMove(12 + (28 << 6) + Wyvern::MOVE_PAWN); // e2e4
+    const U64 e4_key = position.getZobrist();
+    position.makeMove(62 + (45 << 6) + Wyvern::MOVE_KNIGHT); // g8f6
+    ok = expect_eq("position.history_zobrist", position.getHistoryZobrist(2), start_key) && ok;
+    position.unmakeMove();
+    ok = expect_eq("position.undo_ep_square", position.getEpSquare(), 1ULL << 20) && ok;
+    ok = expect_eq("position.undo_zobrist", position.getZobrist(), e4_key) && ok;
+    position.unmakeMove();
+    ok = expect_eq("position.undo_ply", position.getGamePly(), 0) && ok;
+    ok = expect_eq("position.undo_start_zobrist", position.getZobrist(), start_key) && ok;
+  }
+  {
+    Wyvern::Position position(kiwipete_fen);
+    position.makeMove(36 + (53 << 6) + Wyvern::CAPTURE_PAWN + Wyvern::MOVE_KNIGHT); // e5xf7
+    ok = expect_eq("position.board_capture", position.getBoard()[53], Wyvern::KNIGHT) && ok;
+    position.unmakeMove();
+    ok = expect_eq("position.board_undo_victim", position.getBoard()[53], Wyvern::PAWN) && ok;
+    ok = expect_eq("position.board_undo_mover", position.getBoard()[36], Wyvern::KNIGHT) && ok;
+  }
+  {
+    Wyvern::MoveGenerator movegen(Wyvern::MagicTable::shared());
+    Wyvern::Position position(kiwipete_fen);
+    ok = expect_eq("position.board_consistent", walk(movegen, position, 3, board_consistent), 1) &&
+         ok;
+  }
+  {
+    Wyvern::Position start;
+    const Wyvern::PsqtScores& scores = start.getScores();
+    ok = expect_eq("position.scores_material", scores.material[Wyvern::COLOR_WHITE], 3990) && ok;
+    ok = expect_eq("position.scores_phase", scores.phase, 78) && ok;
+    ok = expect_eq("position.scores_symmetric",
+                   scores.middle_game[Wyvern::COLOR_WHITE] ==
+                       scores.middle_game[Wyvern::COLOR_BLACK],
+                   1) &&
+         ok;
+  }
+  {
+    // knight moves keep the pawn structure, a pawn move does not
+    Wyvern::Evaluator evaluator(Wyvern::MagicTable::shared());
+    Wyvern::Position position(kiwipete_fen);
+    const int eval = evaluator.evalPositional(position);
+    position.makeMove(36 + (19 << 6) + Wyvern::MOVE_KNIGHT); // e5d3
+    position.unmakeMove();
+    ok = expect_eq("pawn_hash.same_eval", evaluator.evalPositional(position), eval) && ok;
+    position.makeMove(18 + (33 << 6) + Wyvern::MOVE_KNIGHT); // c3b5
+    evaluator.evalPositional(position);
+    position.unmakeMove();
+    position.makeMove(8 + (16 << 6) + Wyvern::MOVE_PAWN); // a2a3
+    evaluator.evalPositional(position);
+    ok = expect_eq("pawn_hash.hits", evaluator.getPawnHits(), 2) && ok;
+    ok = expect_eq("pawn_hash.probes", evaluator.getPawnProbes(), 4) && ok;
+  }
+  {
+    const std::vector<int16_t> words = random_network_file();
+    auto network = std::make_shared<Wyvern::NnueNetwork>();
+    const char* bytes = reinterpret_cast<const char*>(words.data());
+    const size_t size = Wyvern::NnueNetwork::file_size;
+    ok = expect_eq("nnue.short_file", network->load(bytes, size - 2), 0) && ok;
+    ok = expect_eq("nnue.missing_file", network->load("no/such/file.nnue"), 0) && ok;
+    ok = expect_eq("nnue.load", network->load(bytes, size), 1) && ok;
+
+    Wyvern::MoveGenerator movegen(Wyvern::MagicTable::shared());
+    Wyvern::Position position(kiwipete_fen);
+    position.setNetwork(network.get());
+    auto accumulator_consistent = [&](const Wyvern::Position& p)
+    { return nnue_consistent(*network, p); };
+    ok = expect_eq("nnue.incremental", walk(movegen, position, 3, accumulator_consistent), 1) &&
+         ok;
+
+    // unmaking past the ply the network was set at
+    position.setNetwork(nullptr);
+    position.makeMove(36 + (53 << 6) + Wyvern::CAPTURE_PAWN + Wyvern::MOVE_KNIGHT); // e5xf7
+    position.setNetwork(network.get());
+    position.unmakeMove();
+    ok = expect_eq("nnue.before_network", nnue_consistent(*network, position), 1) && ok;
+
+    Wyvern::Evaluator evaluator(Wyvern::MagicTable::shared());
+    evaluator.setNetwork(network);
+    ok = expect_eq("nnue.eval", evaluator.evalPositional(position),
+                   reference_nnue_eval(words, position)) &&
+         ok;
+    position.makeMove(36 + (53 << 6) + Wyvern::CAPTURE_PAWN + Wyvern::MOVE_KNIGHT);
+    ok = expect_eq("nnue.eval_black", evaluator.evalPositional(position),
+                   reference_nnue_eval(words, position)) &&
+         ok;
+    position.setNetwork(nullptr);
+    ok = expect_eq("nnue.eval_refresh", evaluator.evalPositional(position),
+                   reference_nnue_eval(words, position)) &&
+         ok;
+  }
+  if (Wyvern::cpuHasAvx2())
+  {
+    Wyvern::MoveGenerator movegen(Wyvern::MagicTable::shared());
+    Wyvern::Evaluator scalar(Wyvern::MagicTable::shared());
+    Wyvern::Evaluator simd(Wyvern::MagicTable::shared());
+    scalar.setSimdMobility(false);
+    simd.setSimdMobility(true);
+    ok = expect_eq("simd_mobility.enabled", simd.getSimdMobility(), 1) && ok;
+    // the avx2 mobility gives the same evaluation as the scalar one at every node
+    auto same_eval = [&](const Wyvern::Position& p)
+    { return scalar.evalPositional(p) == simd.evalPositional(p); };
+    Wyvern::Position position(kiwipete_fen);
+    ok = expect_eq("simd_mobility.kiwipete", walk(movegen, position, 3, same_eval), 1) && ok;
+    // queens and promoted pieces fill more than one group of four lanes
+    Wyvern::Position crowded("QQQ5/QQQ5/RRBB4/NN5k/K7/6nn/4bbrr/5qqq");
+    ok = expect_eq("simd_mobility.crowded", walk(movegen, crowded, 2, same_eval), 1) && ok;
+  }
+  {
+    // a little over one chunk of the positions two plies from kiwipete, so
+    // that both threads get some
+    Wyvern::MoveGenerator movegen(Wyvern::MagicTable::shared());
+    Wyvern::Position root(kiwipete_fen);
+    std::vector<Wyvern::Position> positions;
+    Wyvern::MoveList moves;
+    movegen.generateMoves<Wyvern::COLOR_WHITE>(root, true, moves);
+    for (U32 move : moves)
+    {
+      root.makeMove(move);
+      Wyvern::MoveList replies;
+      movegen.generateMoves<Wyvern::COLOR_BLACK>(root, true, replies);
+      for (U32 reply : replies)
+      {
+        if (positions.size() == Wyvern::eval_batch_chunk + 100)
+          break;
+        root.makeMove(reply);
+        positions.push_back(root);
+        root.unmakeMove();
+      }
+      root.unmakeMove();
+    }
+    Wyvern::Evaluator evaluator(Wyvern::MagicTable::shared());
+    std::vector<int> evals(positions.size());
+    evaluator.evaluateBatch(positions, evals, 2);
+    bool same = true;
+    for (size_t i = 0; i < positions.size(); i++)
+      same = same && evals[i] == evaluator.evalPositional(positions[i]);
+    ok = expect_eq("eval_batch.positions", positions.size(), Wyvern::eval_batch_chunk + 100) && ok;
+    ok = expect_eq("eval_batch.same_evals", same, 1) && ok;
+    bool rejected = false;
+    try
+    {
+      evaluator.evaluateBatch(positions, std::span<int>(evals).first(10), 1);
+    }
+    catch (const std::invalid_argument&)
+    {
+      rejected = true;
+    }
+    ok = expect_eq("eval_batch.short_evals", rejected, 1) && ok;
+  }
+  {
+    // copy assignment trims the undo stack but keeps the plies played
+    Wyvern::MoveGenerator movegen(Wyvern::MagicTable::shared());
+    Wyvern::Position played;
+    played.makeMove(Wyvern::parseUciMove(movegen, played, "e2e4"));
+    Wyvern::Position assigned(kiwipete_fen);
+    assigned = played;
+    ok = expect_eq("position.assign_zobrist", assigned.getZobrist(), played.getZobrist()) && ok;
+    ok = expect_eq("position.assign_ply", assigned.getGamePly(), 1) && ok;
+    assigned.makeMove(Wyvern::parseUciMove(movegen, assigned, "e7e5"));
+    assigned.unmakeMove();
+    assigned.unmakeMove();
+    ok = expect_eq("position.assign_unmake", assigned.getZobrist(),
+                   Wyvern::Position().getZobrist()) &&
+         ok;
+  }
+  {
+    Wyvern::MoveGenerator movegen(Wyvern::MagicTable::shared());
+    Wyvern::Position position(kiwipete_fen);
+    U32 castles = Wyvern::parseUciMove(movegen, position, "e1g1");
+    ok = expect_eq("uci.castles", castles & Wyvern::MOVE_SPECIAL, Wyvern::CASTLES) && ok;
+    ok = expect_eq("uci.illegal", Wyvern::parseUciMove(movegen, position, "e2e5"),
+                   Wyvern::MOVE_NONE) &&
+         ok;
+    Wyvern::Position promotion("8/4P1k1/8/8/8/8/8/4K3");
+    U32 queen = Wyvern::parseUciMove(movegen, promotion, "e7e8q");
+    ok = expect_eq("uci.promotion", moveString(queen) == "e7e8q", 1) && ok;
+  }
+  {
+    std::istringstream go("wtime 60000 btime 30000 winc 1000 binc 0 movestogo 10");
+    Wyvern::GoLimits limits = Wyvern::parseGoLimits(go);
+    Wyvern::TimeManager timeman;
+    timeman.start(limits, Wyvern::COLOR_WHITE);
+    ok = expect_eq("timeman.soft_white", timeman.softLimitMs(), 6750) && ok;
+    ok = expect_eq("timeman.hard_white", timeman.hardLimitMs(), 27000) && ok;
+    // the soft limit shrinks as the best move settles and grows back when it
+    // changes
+    timeman.iterationDone(false);
+    timeman.iterationDone(false);
+    ok = expect_eq("timeman.soft_stable", timeman.softLimitMs(), 6075) && ok;
+    timeman.iterationDone(true);
+    ok = expect_eq("timeman.soft_changed", timeman.softLimitMs(), 9450) && ok;
+    timeman.start(limits, Wyvern::COLOR_BLACK);
+    ok = expect_eq("timeman.soft_black", timeman.softLimitMs(), 3000) && ok;
+    ok = expect_eq("timeman.hard_black", timeman.hardLimitMs(), 12000) && ok;
+    // the last move before the time control may use the whole clock
+    limits.btime = 1000;
+    limits.movestogo = 1;
+    timeman.start(limits, Wyvern::COLOR_BLACK);
+    ok = expect_eq("timeman.hard_last_move", timeman.hardLimitMs(), 970) && ok;
+    // a clock at zero or below still limits the search
+    std::istringstream overtime("wtime 0 btime -250 winc 0 binc 0");
+    limits = Wyvern::parseGoLimits(overtime);
+    timeman.start(limits, Wyvern::COLOR_WHITE);
+    ok = expect_eq("timeman.zero_clock", timeman.hardLimitMs(), 1) && ok;
+    timeman.start(limits, Wyvern::COLOR_BLACK);
+    ok = expect_eq("timeman.negative_clock", timeman.hardLimitMs(), 1) && ok;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ok = expect_eq("timeman.negative_clock_expired", timeman.hardExpired(), 1) && ok;
+
+    limits = Wyvern::GoLimits();
+    limits.movetime = 1;
+    limits.ponder = true;
+    timeman.start(limits, Wyvern::COLOR_WHITE);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ok = expect_eq("timeman.pondering", timeman.hardExpired(), false) && ok;
+    timeman.ponderhit();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ok = expect_eq("timeman.ponderhit", timeman.hardExpired(), true) && ok;
+    limits.ponder = false;
+    limits.infinite = true;
+    timeman.start(limits, Wyvern::COLOR_WHITE);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ok = expect_eq("timeman.infinite", timeman.softExpired(), false) && ok;
+  }
+  {
+    // hash move, then pawn takes knight, then the killer, with the queen taking
+    // a defended pawn last
+    Wyvern::MoveGenerator movegen(Wyvern::MagicTable::shared());
+    Wyvern::Evaluator evaluator(Wyvern::MagicTable::shared());
+    Wyvern::Position position("4k3/2p5/3p4/8/5n2/3QP3/8/4K3 w - - 0 1");
+    Wyvern::MoveList moves;
+    movegen.generateMoves<Wyvern::COLOR_WHITE>(position, true, moves);
+    U32 hash_move = Wyvern::parseUciMove(movegen, position, "d3b5");
+    U32 killer = Wyvern::parseUciMove(movegen, position, "d3a6");
+    U32 refuted[] = {Wyvern::parseUciMove(movegen, position, "e1d2"), killer};
+    Wyvern::MoveHistory history;
+    history.cutoff(Wyvern::COLOR_WHITE, 0, 3, Wyvern::MOVE_NONE, refuted, 1);
+    ok = expect_eq("movepick.history_bonus", history.score(Wyvern::COLOR_WHITE, killer) > 0, 1) &&
+         ok;
+    ok = expect_eq("movepick.history_malus",
+                   history.score(Wyvern::COLOR_WHITE, refuted[0]) < 0, 1) &&
+         ok;
+    Wyvern::MovePicker<Wyvern::COLOR_WHITE> picker(moves, position, evaluator, history, 0,
+                                                   hash_move, true);
+    ok = expect_eq("movepick.hash_found", picker.hasHashMove(), 1) && ok;
+    ok = expect_eq("movepick.hash_move", picker.pick(0), hash_move) && ok;
+    ok = expect_eq("movepick.good_capture", picker.pick(1),
+                   Wyvern::parseUciMove(movegen, position, "e3f4")) &&
+         ok;
+    ok = expect_eq("movepick.killer", picker.pick(2), killer) && ok;
+    for (int i = 3; i < static_cast<int>(moves.size()) - 1; i++)
+      picker.pick(i);
+    ok = expect_eq("movepick.bad_capture", picker.pick(moves.size() - 1),
+                   Wyvern::parseUciMove(movegen, position, "d3d6")) &&
+         ok;
+    ok = expect_eq("movepick.killer_kept", picker.pick(2), killer) && ok;
+  }
+  {
+    // a whole session, with the engine's output captured
+    std::ostringstream out;
+    std::streambuf* stdout_buf = std::cout.rdbuf(out.rdbuf());
+    {
+      Wyvern::Uci uci;
+      std::istringstream in("uci\nisready\nsetoption name Hash value 4\n"
+                            "position startpos moves e2e4 e7e5\ngo depth 3\n");
+      uci.loop(in);
+      uci.command("position fen 8/8/8/8/8/6k1/8/6Kq w - - 0 1");
+      uci.command("go infinite");
+      uci.command("stop");
+    }
+    std::cout.rdbuf(stdout_buf);
+    const std::string session = out.str();
+    ok = expect_eq("uci.uciok", session.find("uciok\n") != std::string::npos, 1) && ok;
+    ok = expect_eq("uci.readyok", session.find("readyok\n") != std::string::npos, 1) && ok;
+    ok = expect_eq("uci.depth3", session.find("info depth 3 ") != std::string::npos, 1) && ok;
+    // the only legal move takes the queen
+    ok = expect_eq("uci.bestmove", session.find("bestmove g1h1") != std::string::npos, 1) && ok;
+  }
+  {
+    Wyvern::EvalCache cache(64);
+    int eval = 0;
+    cache.insert(0x123456789ULL, -4321);
+    ok = expect_eq("evalcache.hit", cache.lookup(0x123456789ULL, eval), 1) && ok;
+    ok = expect_eq("evalcache.eval", eval, -4321) && ok;
+    // same slot, different high half
+    ok = expect_eq("evalcache.miss", cache.lookup(0x223456789ULL, eval), 0) && ok;
+    ok = expect_eq("evalcache.size_kb", cache.sizeKB(), 64) && ok;
+    Wyvern::EvalCache empty;
+    empty.insert(0x123456789ULL, 1);
+    ok = expect_eq("evalcache.empty", empty.lookup(0x123456789ULL, eval), 0) && ok;
+  }
   {
     Wyvern::TranspositionTable table(4);
     table.insert(0x1234ULL, Wyvern::BoundedEval(Wyvern::BOUND_LOWER, 42), 3);
@@ -106,6 +594,113 @@ int main()
     ok = expect_bound("transposition.lower_bound", stored.bound, Wyvern::BOUND_LOWER) && ok;
     ok = expect_eq("transposition.lower_eval", stored.eval, 42) && ok;
   }
+  {
+    Wyvern::TranspositionTable table(4);
+    table.insert(0x5678ULL, Wyvern::BoundedEval(Wyvern::BOUND_EXACT, 5 - INT32_MAX), 2);
+    table.insert(0x9ABCULL, Wyvern::BoundedEval(Wyvern::BOUND_UPPER, -1234), 1);
+    const Wyvern::BoundedEval mated = table.lookup(0x5678ULL, 2);
+    const Wyvern::BoundedEval upper = table.lookup(0x9ABCULL, 1);
+    ok = expect_eq("transposition.mate_eval", mated.eval, 5 - INT32_MAX) && ok;
+    ok = expect_bound("transposition.upper_bound", upper.bound, Wyvern::BOUND_UPPER) && ok;
+    ok = expect_eq("transposition.upper_eval", upper.eval, -1234) && ok;
+    ok = expect_bound("transposition.too_shallow", table.lookup(0x9ABCULL, 2).bound,
+                      Wyvern::BOUND_INVALID) &&
+         ok;
+  }
+
+  {
+    // one bucket: a deep entry from an old search gives way to a shallow new one
+    Wyvern::TranspositionTable table(2);
+    for (U64 key = 1; key <= 4; key++)
+      table.insert(key, Wyvern::BoundedEval(Wyvern::BOUND_EXACT, 1), 10);
+    table.newSearch();
+    table.newSearch();
+    table.lookup(2, 0);
+    table.insert(5, Wyvern::BoundedEval(Wyvern::BOUND_EXACT, 5), 1);
+    ok = expect_bound("transposition.aged_out", table.lookup(1, 0).bound,
+                      Wyvern::BOUND_INVALID) &&
+         ok;
+    ok = expect_eq("transposition.refreshed_kept", table.lookup(2, 10).eval, 1) && ok;
+    ok = expect_eq("transposition.new_entry", table.lookup(5, 1).eval, 5) && ok;
+  }
+  {
+    Wyvern::TranspositionTable table(4);
+    table.insert(0x1234ULL, Wyvern::BoundedEval(Wyvern::BOUND_EXACT, 7), 3);
+    table.resize(2, true, 2);
+    ok = expect_eq("transposition.resize_mb", table.sizeMB(), 2) && ok;
+    ok = expect_bound("transposition.resize_clears", table.lookup(0x1234ULL, 0).bound,
+                      Wyvern::BOUND_INVALID) &&
+         ok;
+  }
+  {
+    Wyvern::TranspositionTable table;
+    ok = expect_eq("transposition.lazy_unallocated", table.sizeMB(), 0) && ok;
+    table.insert(0x1234ULL, Wyvern::BoundedEval(Wyvern::BOUND_EXACT, 7), 3);
+    ok = expect_bound("transposition.lazy_miss", table.lookup(0x1234ULL, 0).bound,
+                      Wyvern::BOUND_INVALID) &&
+         ok;
+    ok = expect_eq("transposition.lazy_allocates", table.ensureAllocated(), 1) && ok;
+    ok = expect_eq("transposition.lazy_mb", table.sizeMB(), 128) && ok;
+    ok = expect_eq("transposition.lazy_allocates_once", table.ensureAllocated(), 0) && ok;
+  }
+  {
+    // a deep lower bound narrows alpha for a shallow full window search; a
+    // result at or below it is only an upper bound, and must not go into the
+    // table as exact
+    Wyvern::Search search;
+    search.setNullMovePruning(false);
+    search.clearHash();
+    Wyvern::Position position("r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3");
+    Wyvern::BoundedEval deep = search.negamax<Wyvern::COLOR_WHITE>(position, 3, 31, 32, true, 7);
+    Wyvern::BoundedEval shallow =
+      search.negamax<Wyvern::COLOR_WHITE>(position, 1, -INT32_MAX, INT32_MAX, true, 5);
+    ok = expect_bound("search.narrowed_deep", deep.bound, Wyvern::BOUND_LOWER) && ok;
+    ok = expect_eq("search.narrowed_fail_low", shallow.eval < deep.eval, 1) && ok;
+    ok = expect_bound("search.narrowed_upper", shallow.bound, Wyvern::BOUND_UPPER) && ok;
+    // an exact entry would replace the deeper bound and come back at once
+    Wyvern::BoundedEval probed = search.negamax<Wyvern::COLOR_WHITE>(
+      position, 1, shallow.eval, shallow.eval + 1, true, 5);
+    ok = expect_eq("search.narrowed_not_exact", probed.bound != Wyvern::BOUND_EXACT, 1) && ok;
+  }
+  {
+    // fifty moves for each side draw, not fifty half moves
+    Wyvern::Search search;
+    search.clearHash();
+    Wyvern::Position position("4k3/8/8/8/8/8/8/Q3K3 w - - 60 80");
+    Wyvern::BoundedEval eval =
+      search.negamax<Wyvern::COLOR_WHITE>(position, 3, -INT32_MAX, INT32_MAX, true, 7);
+    ok = expect_eq("search.fifty_move_counting", eval.eval > 500, 1) && ok;
+    search.clearHash();
+    Wyvern::Position drawn("4k3/8/8/8/8/8/8/Q3K3 w - - 99 80");
+    eval = search.negamax<Wyvern::COLOR_WHITE>(drawn, 3, -INT32_MAX, INT32_MAX, true, 7);
+    ok = expect_eq("search.fifty_move_draw", eval.eval, 0) && ok;
+  }
+  {
+    // the public entry points work before the table is allocated
+    Wyvern::Search fresh;
+    Wyvern::Position position;
+    Wyvern::BoundedEval eval =
+      fresh.negamax<Wyvern::COLOR_WHITE>(position, 2, -INT32_MAX, INT32_MAX, true, 2);
+    ok = expect_eq("search.unallocated_negamax", eval.bound != Wyvern::BOUND_INVALID, 1) && ok;
+    Wyvern::MoveGenerator movegen(Wyvern::MagicTable::shared());
+    U32 e4 = Wyvern::parseUciMove(movegen, position, "e2e4");
+    ok = expect_eq("search.unallocated_pv", fresh.principalVariation(position, e4, 4).size(), 1) &&
+         ok;
+  }
+  {
+    ok = expect_eq("magics.shared",
+                   Wyvern::MagicTable::shared().get() == Wyvern::MagicTable::shared().get(), 1) &&
+         ok;
+  }
+  {
+    Wyvern::Search smp_search;
+    smp_search.setThreads(2);
+    Wyvern::Position position;
+    int eval = 0;
+    const U32 move = smp_search.bestmove(position, 10, 2, 2, eval);
+    ok = expect_eq("smp.threads", smp_search.getThreads(), 2) && ok;
+    ok = expect_eq("smp.found_move", move != Wyvern::MOVE_NONE, 1) && ok;
+  }
 
   return ok ? 0 : 1;
 }
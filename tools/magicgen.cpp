@@ -0,0 +1,165 @@
+#include "magicbb.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// offline search for denser slider magics. starting from the magics in
+// magic_numbers.h, each square is retried with one index bit fewer until no
+// magic is found within the trial budget; squares are spread across threads.
+// the result is written in the format of src/magic_numbers.h.
+// usage: wyvern-magicgen [output] [threads] [trials] [seed]
+
+namespace
+{
+
+struct Job
+{
+  Wyvern::PieceType pt;
+  int sq;
+  int bits;
+  U64 magic;
+};
+
+U64 splitmix(U64 state)
+{
+  U64 z = state + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+void shrink(Job& job, U64 trials, U64 seed)
+{
+  // seeded per square so that results do not depend on the thread count
+  U64 rng = splitmix(seed ^ (job.sq + 64 * job.pt)) | 1;
+  while (job.bits > 1)
+  {
+    U64 magic = (job.pt == Wyvern::ROOK)
+                  ? Wyvern::findMagicNum<Wyvern::ROOK>(job.sq, job.bits - 1, rng, trials)
+                  : Wyvern::findMagicNum<Wyvern::BISHOP>(job.sq, job.bits - 1, rng, trials);
+    if (!magic)
+      return;
+    job.magic = magic;
+    job.bits--;
+  }
+}
+
+size_t tableBytes(const std::vector<Job>& jobs)
+{
+  size_t bytes = 0;
+  for (const Job& job : jobs)
+    bytes += sizeof(U64) << job.bits;
+  return bytes;
+}
+
+void writeBits(std::ostream& out, const char* name, const std::vector<Job>& jobs,
+               Wyvern::PieceType pt)
+{
+  out << "constexpr int " << name << "[64] = {\n";
+  for (int rank = 0; rank < 8; rank++)
+  {
+    out << " ";
+    for (int file = 0; file < 8; file++)
+    {
+      const Job& job = jobs[(pt == Wyvern::ROOK) * 64 + rank * 8 + file];
+      out << " " << std::setw(2) << job.bits << ",";
+    }
+    out << "\n";
+  }
+  out << "};\n";
+}
+
+void writeMagics(std::ostream& out, const char* name, const std::vector<Job>& jobs,
+                 Wyvern::PieceType pt)
+{
+  out << "constexpr U64 " << name << "[64] = {\n";
+  for (int row = 0; row < 16; row++)
+  {
+    out << " ";
+    for (int i = 0; i < 4; i++)
+    {
+      const Job& job = jobs[(pt == Wyvern::ROOK) * 64 + row * 4 + i];
+      out << " 0x" << std::hex << std::setw(16) << std::setfill('0') << job.magic << "ULL,"
+          << std::dec << std::setfill(' ');
+    }
+    out << "\n";
+  }
+  out << "};\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  std::string output = (argc > 1) ? argv[1] : "magic_numbers.h";
+  int threads = (argc > 2) ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+  U64 trials = (argc > 3) ? std::strtoull(argv[3], nullptr, 10) : 100000000;
+  U64 seed = (argc > 4) ? std::strtoull(argv[4], nullptr, 10) : 1;
+  threads = std::max(threads, 1);
+
+  // bishops in 0-63, rooks in 64-127, as in MagicTable
+  std::vector<Job> jobs;
+  for (int sq = 0; sq < 64; sq++)
+    jobs.push_back({Wyvern::BISHOP, sq, Wyvern::magicBBits[sq], Wyvern::bishop_magic_numbers[sq]});
+  for (int sq = 0; sq < 64; sq++)
+    jobs.push_back({Wyvern::ROOK, sq, Wyvern::magicRBits[sq], Wyvern::rook_magic_numbers[sq]});
+  size_t bytes_before = tableBytes(jobs);
+
+  std::atomic<size_t> next_job = 0;
+  std::mutex print_mutex;
+  auto work = [&]()
+  {
+    for (size_t i = next_job++; i < jobs.size(); i = next_job++)
+    {
+      int bits_before = jobs[i].bits;
+      shrink(jobs[i], trials, seed);
+      std::lock_guard<std::mutex> lock(print_mutex);
+      std::cout << ((jobs[i].pt == Wyvern::ROOK) ? "rook   " : "bishop ");
+      printSq(jobs[i].sq);
+      std::cout << ": " << bits_before << " -> " << jobs[i].bits << " bits" << std::endl;
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int t = 1; t < threads; t++)
+    workers.emplace_back(work);
+  work();
+  for (auto& w : workers)
+    w.join();
+
+  std::ostringstream header;
+  header << "#pragma once\n\n"
+         << "// slider magics and their index bits, as written by wyvern-magicgen.\n"
+         << "// regenerate with: wyvern-magicgen src/magic_numbers.h\n\n"
+         << "#include \"types.h\"\n\n"
+         << "namespace Wyvern\n{\n\n"
+         << "// clang-format off\n";
+  writeBits(header, "magicRBits", jobs, Wyvern::ROOK);
+  header << "\n";
+  writeBits(header, "magicBBits", jobs, Wyvern::BISHOP);
+  header << "\n";
+  writeMagics(header, "rook_magic_numbers", jobs, Wyvern::ROOK);
+  header << "\n";
+  writeMagics(header, "bishop_magic_numbers", jobs, Wyvern::BISHOP);
+  header << "// clang-format on\n\n"
+         << "} // namespace Wyvern\n";
+
+  std::ofstream file(output);
+  if (!file)
+  {
+    std::cerr << "cannot write " << output << std::endl;
+    return 1;
+  }
+  file << header.str();
+  std::cout << "slider table " << bytes_before / 1024 << "KB -> " << tableBytes(jobs) / 1024
+            << "KB, written to " << output << std::endl;
+  return 0;
+}